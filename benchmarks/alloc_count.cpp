@@ -0,0 +1,69 @@
+// alloc_count.cpp
+//
+// Replaces the global operator new and delete to count allocations for
+// bench::alloc_counts(). Linked, as the alloc_count object library, into
+// the benchmarks that report allocations. Kept out of line so the
+// compiler doesn't see operator new paired with malloc/free.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+#include "harness.h"
+
+namespace {
+  void count(std::size_t size) {
+    bench::detail::num_allocs.fetch_add(1, std::memory_order_relaxed);
+    bench::detail::num_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+  }
+
+  void* aligned_malloc(std::size_t size, std::size_t alignment) {
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    // aligned_alloc wants a multiple of the alignment
+    size = (size + alignment - 1) / alignment * alignment;
+    return std::aligned_alloc(alignment, size);
+#endif
+  }
+
+  void aligned_free(void* ptr) {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+  }
+
+  const bool counting = [] {
+    bench::detail::alloc_counting.store(true, std::memory_order_relaxed);
+    return true;
+  }();
+}  // namespace
+
+// the array and nothrow forms call this one
+void* operator new(std::size_t size) {
+  count(size);
+  if (auto ptr = std::malloc(size ? size : 1)) return ptr;
+  throw std::bad_alloc{};
+}
+
+void* operator new(std::size_t size, std::align_val_t align) {
+  count(size);
+  if (auto ptr = aligned_malloc(size ? size : 1, (std::size_t)align)) {
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept {
+  aligned_free(ptr);
+}
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+  aligned_free(ptr);
+}
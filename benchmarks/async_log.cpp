@@ -0,0 +1,45 @@
+// async_log.cpp
+//
+// nested workload with info logging compiled in, run with logging off,
+// with synchronous logging, and with the asynchronous backend. Redirect
+// stdout (e.g. to /dev/null) to measure logging cost rather than the
+// terminal.
+
+#include <iostream>
+#include "harness.h"
+#include "internal/cope_log.h"
+#include "nested.h"
+
+namespace {
+  void run(bench::harness_t& harness, const char* name) {
+    using namespace nested;
+    context_t context{};
+    auto task{
+        cope::txn::basic_handler<txn::task_t, outer::txn::manager_t, context_t>(
+            context, kOuterTxnId)};
+    harness.run(name, [&task](int iter) { outer::txn::send_next(task, iter); });
+  }
+}  // namespace
+
+int main(int argc, char* argv[]) {
+#ifndef NDEBUG
+  bench::options_t defaults{.iters{10}};
+#else
+  bench::options_t defaults{.iters{200'000}, .warmup{2'000}, .reps{5}};
+#endif
+  bench::harness_t harness{bench::parse_args(argc, argv, defaults)};
+  static_assert(cope::log::compiled(cope::log::level::info),
+      "async_log requires COPE_LOG_LEVEL=COPE_LOG_LEVEL_INFO");
+
+  cope::log::enable(false);
+  run(harness, "nested (logging off)");
+
+  cope::log::enable();
+  run(harness, "nested (sync logging)");
+
+  cope::log::async::start({.ring_capacity = 64 * 1024});
+  run(harness, "nested (async logging)");
+  cope::log::async::stop();
+  std::cerr << "  dropped: " << cope::log::async::dropped() << std::endl;
+  return harness.finish();
+}
@@ -0,0 +1,151 @@
+// compact.cpp
+//
+// context_t footprint and send_msg latency with std::variant message
+// storage (type_bundle_t) and with msg::compact_variant_t storage
+// (compact_type_bundle_t), as the bundle grows from 3 to 51 message
+// types. Each op is a start_txn_t carrying a 128-byte state, which the
+// txn answers with a yield, and a small message that completes the txn.
+// Also checks that moving a large message's variant moves only its buffer.
+
+#include <array>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "cope.h"
+#include "cope_handler/basic.h"
+#include "cope_msg_compact.h"
+#include "harness.h"
+
+namespace compact {
+  constexpr auto kTxnId{ cope::txn::make_id(100) };
+
+  namespace msg {
+    struct data_t {
+      int value;
+    };
+
+    struct out_t {
+      int value;
+    };
+
+    // other messages in the bundle, of 8 to 104 bytes
+    template <std::size_t I>
+    struct filler_t {
+      std::array<int, 2 + (I % 4) * 8> values;
+    };
+  }  // namespace msg
+
+  namespace txn {
+    struct state_t {
+      std::array<char, 64> name;
+      std::array<int, 16> values;
+    };
+  }  // namespace txn
+
+  namespace msg {
+    using start_txn_t = cope::msg::start_txn_t<data_t, txn::state_t>;
+
+    // 3 + 2 * NumFillers message types
+    template <std::size_t NumFillers>
+    struct types {
+      template <std::size_t... Is>
+      static auto in(std::index_sequence<Is...>)
+          -> std::tuple<start_txn_t, data_t, filler_t<2 * Is>...>;
+      template <std::size_t... Is>
+      static auto out(std::index_sequence<Is...>)
+          -> std::tuple<out_t, filler_t<2 * Is + 1>...>;
+
+      using in_tuple_t = decltype(in(std::make_index_sequence<NumFillers>{}));
+      using out_tuple_t =
+          decltype(out(std::make_index_sequence<NumFillers>{}));
+    };
+  }  // namespace msg
+
+  namespace txn {
+    template <typename ContextT>
+    using task_t = cope::txn::task_t<msg::data_t, state_t, ContextT>;
+
+    template <typename ContextT>
+    struct manager_t : cope::txn::basic_manager_t<state_t, ContextT> {
+      using base = typename manager_t::basic_manager_t;
+
+      manager_t(ContextT&) {}
+
+      cope::expected_operation update_state(
+          const ContextT& context, state_t&) {
+        return cope::msg::get_if<msg::data_t>(context.in())->value
+                   ? cope::operation::complete
+                   : cope::operation::yield;
+      }
+
+      base::yield_msg_type get_yield_msg(const state_t& state) {
+        return msg::out_t{state.values[0]};
+      }
+    };  // struct manager_t
+  }  // namespace txn
+
+  template <typename BundleT>
+  void run(bench::harness_t& harness, const std::string& name) {
+    using context_type = cope::txn::context_t<BundleT>;
+    context_type context{};
+    auto task{cope::txn::basic_handler<txn::task_t, txn::manager_t>(
+        context, kTxnId)};
+    std::cerr << name << ": sizeof(context_t) " << sizeof(context_type)
+              << " (in " << sizeof(typename context_type::in_msg_type)
+              << ", out " << sizeof(typename context_type::out_msg_type)
+              << ")" << std::endl;
+    txn::state_t state{{"magic beans"}, {1}};
+    harness.run(name, [&task, &state](int iter) {
+      [[maybe_unused]] const auto& out =
+          task.send_msg(msg::start_txn_t{msg::data_t{0}, state});
+      [[maybe_unused]] const auto& done =
+          task.send_msg(msg::data_t{iter | 1});
+      return 2;
+    });
+  }
+
+  // Moving a compact_variant_t that holds a start_txn_t, which is stored
+  // out of line, must move only its buffer.
+  void check_move(bench::harness_t& harness) {
+    using variant_type = cope::msg::compact_type_bundle_t<
+        msg::types<0>>::in_msg_type;
+    static_assert(std::is_nothrow_move_constructible_v<variant_type>);
+    static_assert(std::is_nothrow_move_assignable_v<variant_type>);
+    variant_type from{
+        msg::start_txn_t{msg::data_t{7}, txn::state_t{{"magic beans"}, {1}}}};
+    const auto held = from.get_if<msg::start_txn_t>();
+    variant_type to{std::move(from)};
+    from = std::move(to);
+    if ((from.get_if<msg::start_txn_t>() != held) || (held->msg.value != 7)) {
+      harness.fail("compact", "a large message was moved, not its buffer");
+    }
+  }
+
+  template <std::size_t NumFillers>
+  void run_both(bench::harness_t& harness) {
+    using types = msg::types<NumFillers>;
+    const auto num_types = std::tuple_size_v<typename types::in_tuple_t>
+                           + std::tuple_size_v<typename types::out_tuple_t>;
+    const auto suffix = " (" + std::to_string(num_types) + " types)";
+    run<cope::msg::type_bundle_t<types>>(harness, "variant" + suffix);
+    run<cope::msg::compact_type_bundle_t<types>>(harness, "compact" + suffix);
+  }
+}  // namespace compact
+
+int main(int argc, char* argv[]) {
+#ifndef NDEBUG
+  cope::log::enable();
+  bench::options_t defaults{.iters{2}};
+#else
+  bench::options_t defaults{.iters{2'000'000}, .warmup{20'000}, .reps{5}};
+#endif
+  bench::harness_t harness{bench::parse_args(argc, argv, defaults)};
+  compact::check_move(harness);
+  compact::run_both<0>(harness);
+  compact::run_both<4>(harness);
+  compact::run_both<11>(harness);
+  compact::run_both<24>(harness);
+  return harness.finish();
+}
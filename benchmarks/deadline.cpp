@@ -0,0 +1,141 @@
+// deadline.cpp
+//
+// Txn deadlines armed in a timer::wheel_t. Measures starting and
+// completing a txn with no deadline and with one, while 0, 10k and 1M
+// other timers are armed in the wheel, which should cost the same; and
+// aborting a yielding txn whose deadline expires.
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <variant>
+#include "cope.h"
+#include "cope_handler/basic.h"
+#include "cope_timer_wheel.h"
+#include "harness.h"
+
+namespace deadline_bench {
+  using namespace std::chrono_literals;
+  using clock_type = cope::timer::clock_type;
+
+  constexpr auto kTxnId{ cope::txn::make_id(100) };
+
+  namespace msg {
+    struct data_t {
+      int value;
+    };
+
+    struct out_t {
+      int value;
+    };
+  }  // namespace msg
+
+  namespace txn {
+    struct state_t {
+      int yields;  // before completing
+      std::optional<std::chrono::milliseconds> timeout;
+    };
+  }  // namespace txn
+
+  namespace msg {
+    using start_txn_t = cope::msg::start_txn_t<data_t, txn::state_t>;
+
+    struct types {
+      using in_tuple_t = std::tuple<start_txn_t, data_t>;
+      using out_tuple_t = std::tuple<out_t>;
+    };
+  }  // namespace msg
+
+  using type_bundle_t = cope::msg::type_bundle_t<msg::types>;
+  using context_t = cope::txn::context_t<type_bundle_t>;
+
+  namespace txn {
+    template <typename ContextT>
+    using task_t = cope::txn::task_t<msg::data_t, state_t, ContextT>;
+
+    template <typename ContextT>
+    struct manager_t : cope::txn::basic_manager_t<state_t, ContextT> {
+      using base = typename manager_t::basic_manager_t;
+
+      manager_t(ContextT&) {}
+
+      auto deadline(const state_t& state) const { return state.timeout; }
+
+      cope::expected_operation update_state(const ContextT&, state_t& state) {
+        if (state.yields-- > 0) return cope::operation::yield;
+        return cope::operation::complete;
+      }
+
+      base::yield_msg_type get_yield_msg(const state_t& state) {
+        return msg::out_t{state.yields};
+      }
+    };  // struct manager_t
+  }  // namespace txn
+
+  void run_complete(bench::harness_t& harness, const std::string& name,
+      std::optional<std::chrono::milliseconds> timeout, int num_timers) {
+    cope::timer::wheel_t wheel;
+    // far enough out that none expire
+    auto timers = std::make_unique<cope::timer::node_t[]>(num_timers);
+    const auto later = clock_type::now() + 1h;
+    for (int idx{}; idx < num_timers; ++idx) wheel.arm(timers[idx], later);
+
+    context_t context{};
+    context.set_deadline_wheel(&wheel);
+    auto task{cope::txn::basic_handler<txn::task_t, txn::manager_t>(
+        context, kTxnId)};
+    harness.run(name, [&task, timeout](int) {
+      [[maybe_unused]] const auto& out =
+          task.send_msg(msg::start_txn_t{msg::data_t{0}, {0, timeout}});
+    });
+    if (wheel.size() != (std::size_t)num_timers) {
+      harness.fail(name, "deadline left armed");
+    }
+  }
+
+  // Each op starts a txn that yields forever, with a 1ms deadline, then
+  // advances the wheel 2ms, which aborts it.
+  void run_expire(bench::harness_t& harness) {
+    auto time = clock_type::now();
+    cope::timer::wheel_t wheel{1ms, time};
+    context_t context{};
+    context.set_deadline_wheel(&wheel);
+    auto task{cope::txn::basic_handler<txn::task_t, txn::manager_t>(
+        context, kTxnId)};
+    int aborted{};
+    auto on_out = [&aborted](const context_t& context,
+                      const context_t::out_msg_type&) {
+      aborted += context.result().code == cope::result_code::e_abort;
+    };
+    harness.run("deadline (expire)", [&](int) {
+      [[maybe_unused]] const auto& out =
+          task.send_msg(msg::start_txn_t{msg::data_t{0}, {1 << 30, 1ms}});
+      time += 2ms;
+      cope::txn::expire_deadlines<context_t>(wheel, time, on_out);
+    });
+    if (!aborted || wheel.size()) {
+      harness.fail("deadline (expire)", "txn not aborted");
+    }
+  }
+}  // namespace deadline_bench
+
+int main(int argc, char* argv[]) {
+  using namespace deadline_bench;
+#ifndef NDEBUG
+  cope::log::enable();
+  bench::options_t defaults{.iters{4}};
+#else
+  bench::options_t defaults{.iters{1'000'000}, .warmup{10'000}, .reps{5}};
+#endif
+  bench::harness_t harness{bench::parse_args(argc, argv, defaults)};
+  run_complete(harness, "deadline (none)", std::nullopt, 0);
+  for (int num_timers : {0, 10'000, 1'000'000}) {
+    run_complete(harness,
+        "deadline (armed, " + std::to_string(num_timers) + " timers)", 1s,
+        num_timers);
+  }
+  run_expire(harness);
+  return harness.finish();
+}
@@ -0,0 +1,130 @@
+// depth.cpp
+//
+// Cost of nested txn transitions by nesting depth. Each op starts a txn
+// that awaits a chain of `depth` nested txns; the innermost yields, then
+// completes on the next message, and every txn in the chain completes in
+// turn. ns/unit is per transition (one await down or one return up), and
+// should not grow with depth.
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include "cope.h"
+#include "cope_handler/basic.h"
+#include "harness.h"
+
+namespace depth {
+  constexpr auto kTxnId{ cope::txn::make_id(100) };
+  constexpr int kMaxDepth{64};
+
+  namespace msg {
+    struct data_t {
+      int value;
+    };
+
+    struct out_t {
+      int level;
+    };
+  }  // namespace msg
+
+  namespace txn {
+    struct state_t {
+      int level;
+      int depth;
+      bool awaited;
+    };
+  }  // namespace txn
+
+  namespace msg {
+    using start_txn_t = cope::msg::start_txn_t<data_t, txn::state_t>;
+
+    struct types {
+      using in_tuple_t = std::tuple<start_txn_t, data_t>;
+      using out_tuple_t = std::tuple<out_t>;
+    };
+  }  // namespace msg
+
+  using type_bundle_t = cope::msg::type_bundle_t<msg::types>;
+  using context_t = cope::txn::context_t<type_bundle_t>;
+
+  namespace txn {
+    template <typename ContextT>
+    using task_t = cope::txn::task_t<msg::data_t, state_t, ContextT>;
+
+    using task_type = task_t<context_t>;
+    using start_awaiter = cope::txn::start_awaitable<task_type>;
+
+    // Every level runs the same manager. A level above the innermost
+    // awaits the next level's task, created the first time it is needed.
+    template <typename ContextT>
+    struct manager_t : cope::txn::basic_manager_t<state_t, ContextT> {
+      using context_type = ContextT;
+      using base = typename manager_t::basic_manager_t;
+      using state_type = base::state_type;
+      using yield_msg_type = base::yield_msg_type;
+      using awaiter_types = std::tuple<start_awaiter>;
+
+      manager_t(context_type&) {}
+
+      cope::expected_operation update_state(
+          const context_type&, state_type& state) {
+        if (state.level < state.depth) {
+          if (state.awaited) return cope::operation::complete;
+          state.awaited = true;
+          return cope::operation::await;
+        }
+        if (state.awaited) return cope::operation::complete;
+        state.awaited = true;
+        return cope::operation::yield;
+      }
+
+      yield_msg_type get_yield_msg(const state_type& state) {
+        return msg::out_t{state.level};
+      }
+
+      cope::result_t get_awaiter(context_type& context,
+          const state_type& state, start_awaiter& awaiter) {
+        if (!next_) {
+          next_.reset(new task_type(
+              cope::txn::basic_handler<task_t, manager_t>(context, kTxnId)));
+        }
+        awaiter = start_awaiter{next_->handle(), msg::data_t{state.level},
+            state_t{state.level + 1, state.depth, false}};
+        return {};
+      }
+
+    private:
+      std::unique_ptr<task_type> next_;
+    };  // struct manager_t
+  }  // namespace txn
+
+  void run(bench::harness_t& harness, int depth, int iters) {
+    context_t context{};
+    auto task{cope::txn::basic_handler<txn::task_t, txn::manager_t>(
+        context, kTxnId)};
+    harness.run("depth " + std::to_string(depth), iters, [&](int) {
+      using msg::start_txn_t;
+      [[maybe_unused]] const auto& out = task.send_msg(
+          start_txn_t{msg::data_t{0}, txn::state_t{0, depth, false}});
+      [[maybe_unused]] const auto& done = task.send_msg(msg::data_t{1});
+      return 2 * depth;
+    });
+  }
+}  // namespace depth
+
+int main(int argc, char* argv[]) {
+#ifndef NDEBUG
+  cope::log::enable();
+  bench::options_t defaults{.iters{2}};
+#else
+  bench::options_t defaults{.iters{1'000'000}, .warmup{1'000}, .reps{5}};
+#endif
+  bench::harness_t harness{bench::parse_args(argc, argv, defaults)};
+  auto iters = harness.options().iters;
+  for (int depth{1}; depth <= depth::kMaxDepth; depth *= 2) {
+    // roughly constant transitions per depth
+    depth::run(harness, depth, std::max(1, iters / depth));
+  }
+  return harness.finish();
+}
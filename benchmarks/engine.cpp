@@ -0,0 +1,92 @@
+// engine.cpp
+//
+// The nested workload on engine sessions, run by 1 to
+// engine::default_num_workers() workers. Each op sends every session iters
+// more messages, in quanta of kQuantum per engine step; ns are reported
+// per message. Also checks that every session received all its messages.
+
+#include <algorithm>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include "cope_engine.h"
+#include "harness.h"
+#include "nested.h"
+
+namespace {
+  using task_type = nested::txn::task_t<nested::context_t>;
+
+  struct session_t : cope::engine::session_t<nested::context_t, task_type> {
+    using base = cope::engine::session_t<nested::context_t, task_type>;
+
+    session_t()
+        : base([](nested::context_t& context) {
+            return cope::txn::basic_handler<nested::txn::task_t,
+                nested::outer::txn::manager_t, nested::context_t>(
+                context, nested::kOuterTxnId);
+          }) {}
+
+    int iter{};
+    int num_iter{};
+  };
+
+  // messages sent to a session per engine step
+  constexpr int kQuantum{1024};
+
+  double run(bench::harness_t& harness, unsigned num_workers,
+      int num_sessions) {
+    cope::engine::engine_t<session_t> engine{num_workers};
+    for (int idx{}; idx < num_sessions; ++idx) engine.emplace_session();
+    const auto iters = harness.options().iters;
+    const auto name = "engine/nested x" + std::to_string(num_workers);
+    const auto stats = harness.run(name, 1, [&engine, iters](int) {
+      for (std::size_t idx{}; idx < engine.num_sessions(); ++idx) {
+        engine.session(idx).num_iter += iters;
+      }
+      engine.run([](session_t& session) {
+        auto end = std::min(session.iter + kQuantum, session.num_iter);
+        for (; session.iter < end; ++session.iter) {
+          nested::outer::txn::send_next(session.task(), session.iter);
+        }
+        return session.iter < session.num_iter;
+      });
+      return engine.num_sessions() * (std::size_t)iters;
+    });
+    for (std::size_t idx{}; idx < engine.num_sessions(); ++idx) {
+      const auto& session = engine.session(idx);
+      if (session.iter != session.num_iter) {
+        harness.fail(name, "session " + std::to_string(idx) + " unfinished");
+      }
+    }
+    if (num_workers == 1) {
+      auto frames = engine.frame_stats();
+      std::cerr << "frames: " << frames.frames_in_use << " ("
+                << frames.bytes_in_use << " bytes in use, "
+                << frames.bytes_reserved << " bytes reserved)" << std::endl;
+    }
+    return stats.mean;
+  }
+}  // namespace
+
+int main(int argc, char* argv[]) {
+#ifndef NDEBUG
+  cope::log::enable();
+  bench::options_t defaults{.iters{10}};
+  int num_sessions{ 4 };
+#else
+  bench::options_t defaults{.iters{20'000}, .warmup{1}, .reps{5}};
+  int num_sessions{ 256 };
+#endif
+  bench::harness_t harness{bench::parse_args(argc, argv, defaults)};
+
+  const auto max_workers = cope::engine::default_num_workers();
+  double base_ns{};
+  for (unsigned workers{1}; workers <= max_workers; ++workers) {
+    auto ns = run(harness, workers, num_sessions);
+    if (workers == 1) base_ns = ns;
+    std::cerr << "  speedup: " << std::fixed << std::setprecision(2)
+              << base_ns / ns << std::endl;
+  }
+  return harness.finish();
+}
@@ -0,0 +1,191 @@
+// event.cpp
+//
+// A txn that alternates between suspending on an event::loop_t awaitable
+// and yielding. Each op sends the txn a message, which it answers by
+// suspending on the event, then runs the loop, which resumes the txn
+// to its next yield. Measures the loop's cost per event for an expired
+// timer and a readable eventfd, and the wakeup latency of a 50us timer.
+// Also checks that destroying a task suspended on an event removes the
+// event from the loop.
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include <variant>
+#include "cope.h"
+#include "cope_event.h"
+#include "cope_handler/basic.h"
+#include "harness.h"
+
+namespace event_bench {
+  using namespace std::chrono_literals;
+
+  constexpr auto kTxnId{ cope::txn::make_id(100) };
+
+  enum class kind : int {
+    timer,
+    readable
+  };
+
+  namespace msg {
+    struct data_t {
+      int value;
+    };
+
+    struct out_t {
+      int value;
+    };
+  }  // namespace msg
+
+  namespace txn {
+    struct state_t {
+      kind wait_on;
+      int step;
+    };
+  }  // namespace txn
+
+  namespace msg {
+    using start_txn_t = cope::msg::start_txn_t<data_t, txn::state_t>;
+
+    struct types {
+      using in_tuple_t = std::tuple<start_txn_t, data_t>;
+      using out_tuple_t = std::tuple<out_t>;
+    };
+  }  // namespace msg
+
+  using type_bundle_t = cope::msg::type_bundle_t<msg::types>;
+  using context_t = cope::txn::context_t<type_bundle_t>;
+  using loop_t = cope::event::loop_t<context_t>;
+
+  // shared with the manager, which is constructed by basic_handler
+  struct env_t {
+    loop_t loop;
+    int event_fd{::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)};
+    std::chrono::nanoseconds delay{};
+
+    ~env_t() { ::close(event_fd); }
+  };
+
+  env_t* env{};
+
+  namespace txn {
+    template <typename ContextT>
+    using task_t = cope::txn::task_t<msg::data_t, state_t, ContextT>;
+
+    // Awaits an event on every even step and yields on every odd one.
+    template <typename ContextT>
+    struct manager_t : cope::txn::basic_manager_t<state_t, ContextT> {
+      using base = typename manager_t::basic_manager_t;
+      using awaiter_types =
+          std::tuple<cope::event::sleep_awaitable<ContextT>,
+              cope::event::readable_awaitable<ContextT>>;
+      using awaiter_type = cope::txn::detail::awaiter_for_t<awaiter_types>;
+
+      manager_t(ContextT&) {}
+
+      cope::expected_operation update_state(const ContextT&, state_t& state) {
+        if (state.step++ % 2) {
+          if (state.wait_on == kind::readable) {
+            std::uint64_t count;
+            [[maybe_unused]] auto rc =
+                ::read(env->event_fd, &count, sizeof(count));
+          }
+          return cope::operation::yield;
+        }
+        return cope::operation::await;
+      }
+
+      cope::result_t get_awaiter(ContextT&, const state_t& state,
+          awaiter_type& awaiter) {
+        if (state.wait_on == kind::timer) {
+          awaiter = cope::event::sleep_awaitable<ContextT>{env->loop,
+              env->delay};
+        } else {
+          awaiter = cope::event::readable_awaitable<ContextT>{env->loop,
+              env->event_fd};
+        }
+        return {};
+      }
+
+      base::yield_msg_type get_yield_msg(const state_t& state) {
+        return msg::out_t{state.step};
+      }
+    };  // struct manager_t
+  }  // namespace txn
+
+  void run(bench::harness_t& harness, const char* name, kind wait_on,
+      int iters) {
+    context_t context{};
+    auto task{cope::txn::basic_handler<txn::task_t, txn::manager_t>(
+        context, kTxnId)};
+    int yields{};
+    auto on_out = [&yields](const context_t&,
+                      const context_t::out_msg_type& out) {
+      yields += std::holds_alternative<msg::out_t>(out);
+    };
+    // send msg, signal the event if it is an fd, and run the loop
+    auto step = [&task, &on_out, wait_on](auto&& msg) {
+      [[maybe_unused]] const auto& out = task.send_msg(std::move(msg));
+      if (wait_on == kind::readable) {
+        const std::uint64_t one{1};
+        [[maybe_unused]] auto rc = ::write(env->event_fd, &one, sizeof(one));
+      }
+      env->loop.run(on_out);
+    };
+    step(msg::start_txn_t{msg::data_t{0}, txn::state_t{wait_on, 0}});
+    harness.run(name, iters, [&step](int) { step(msg::data_t{1}); });
+    if (yields < iters) harness.fail(name, "missed yields");
+  }
+
+  // Tasks suspended on a timer that won't expire and on an fd that won't
+  // become readable are destroyed; the loop must forget both events.
+  void check_cancel(bench::harness_t& harness) {
+    const auto name = "event (cancel)";
+    const auto delay = std::exchange(env->delay, 1h);
+    {
+      context_t timer_context{};
+      auto timer_task{cope::txn::basic_handler<txn::task_t, txn::manager_t>(
+          timer_context, kTxnId)};
+      context_t reader_context{};
+      auto reader_task{cope::txn::basic_handler<txn::task_t, txn::manager_t>(
+          reader_context, kTxnId)};
+      [[maybe_unused]] const auto& out1 = timer_task.send_msg(
+          msg::start_txn_t{msg::data_t{0}, txn::state_t{kind::timer, 0}});
+      [[maybe_unused]] const auto& out2 = reader_task.send_msg(
+          msg::start_txn_t{msg::data_t{0}, txn::state_t{kind::readable, 0}});
+      if (env->loop.num_waiting() != 2) harness.fail(name, "not suspended");
+    }
+    env->delay = delay;
+    if (env->loop.num_waiting()) harness.fail(name, "events not removed");
+    // the fd is no longer watched, so this resumes nothing
+    const std::uint64_t one{1};
+    [[maybe_unused]] auto rc = ::write(env->event_fd, &one, sizeof(one));
+    auto resumed = env->loop.run_once([](const auto&, const auto&) {}, 0ms);
+    if (resumed) harness.fail(name, "destroyed txn resumed");
+    std::uint64_t count;
+    rc = ::read(env->event_fd, &count, sizeof(count));
+  }
+}  // namespace event_bench
+
+int main(int argc, char* argv[]) {
+  using namespace event_bench;
+#ifndef NDEBUG
+  cope::log::enable();
+  bench::options_t defaults{.iters{4}};
+#else
+  bench::options_t defaults{.iters{200'000}, .warmup{2'000}, .reps{5}};
+#endif
+  bench::harness_t harness{bench::parse_args(argc, argv, defaults)};
+  env_t shared;
+  env = &shared;
+  check_cancel(harness);
+  const auto iters = harness.options().iters;
+  run(harness, "event (expired timer)", kind::timer, iters);
+  run(harness, "event (readable fd)", kind::readable, iters);
+  shared.delay = 50us;
+  run(harness, "event (50us timer)", kind::timer, std::max(1, iters / 100));
+  return harness.finish();
+}
@@ -0,0 +1,249 @@
+// harness.cpp
+
+#include "harness.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#ifdef __linux__
+#include <sched.h>
+#elif defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace bench {
+  namespace detail {
+    constinit std::atomic<std::uint64_t> num_allocs{};
+    constinit std::atomic<std::uint64_t> num_alloc_bytes{};
+    constinit std::atomic<bool> alloc_counting{};
+  }  // namespace detail
+
+  bool counting_allocs() {
+    return detail::alloc_counting.load(std::memory_order_relaxed);
+  }
+
+  alloc_counts_t alloc_counts() {
+    return {detail::num_allocs.load(std::memory_order_relaxed),
+        detail::num_alloc_bytes.load(std::memory_order_relaxed)};
+  }
+
+  namespace {
+    bool pin_to_cpu(int cpu) {
+#ifdef __linux__
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(cpu, &set);
+      return !sched_setaffinity(0, sizeof(set), &set);
+#elif defined(_WIN32)
+      return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{1} << cpu);
+#else
+      (void)cpu;
+      return false;
+#endif
+    }
+
+    double percentile(const std::vector<double>& sorted, double pct) {
+      if (sorted.empty()) return 0.0;
+      auto idx = (std::size_t)std::ceil(pct / 100.0 * sorted.size());
+      return sorted[std::min(sorted.size(), std::max<std::size_t>(idx, 1)) - 1];
+    }
+
+    std::string escape(std::string_view str) {
+      std::string result;
+      for (auto c : str) {
+        if (c == '"' || c == '\\') result += '\\';
+        result += c;
+      }
+      return result;
+    }
+
+    void write_json(std::ostream& os, const std::vector<stats_t>& results) {
+      os << std::fixed << std::setprecision(2) << "{\n  \"benchmarks\": [";
+      for (std::size_t idx{}; idx < results.size(); ++idx) {
+        const auto& r = results[idx];
+        os << (idx ? "," : "") << "\n    {\"name\": \"" << escape(r.name)
+           << "\", \"iters\": " << r.iters << ", \"units\": " << r.units
+           << ", \"reps\": " << r.reps << ", \"mean\": " << r.mean
+           << ", \"min\": " << r.min << ", \"max\": " << r.max
+           << ", \"stddev\": " << r.stddev << ", \"p50\": " << r.p50
+           << ", \"p99\": " << r.p99 << ", \"p999\": " << r.p999
+           << ", \"samples\": " << r.samples;
+        if (counting_allocs()) {
+          os << ", \"allocs\": " << r.allocs << ", \"alloc_bytes\": "
+             << r.alloc_bytes;
+        }
+        os << "}";
+      }
+      os << "\n  ]\n}\n";
+    }
+
+    // For --no-allocs: 1 if any benchmark allocated in its timed ops, 2 if
+    // allocations aren't counted.
+    int check_no_allocs(const std::vector<stats_t>& results) {
+      if (!counting_allocs()) {
+        std::cerr << "--no-allocs: allocations aren't counted; link "
+                     "alloc_count" << std::endl;
+        return 2;
+      }
+      int allocating{};
+      for (const auto& r : results) {
+        if (r.allocs <= 0.0) continue;
+        ++allocating;
+        std::cerr << std::fixed << std::setprecision(2) << r.name << ": "
+                  << r.allocs << " allocs/unit ALLOCATES" << std::endl;
+      }
+      return allocating ? 1 : 0;
+    }
+
+    // Reads back the name and mean of each benchmark in a file written by
+    // write_json(). Not a general purpose JSON parser.
+    std::map<std::string, double> read_baseline(const std::string& path) {
+      std::map<std::string, double> baseline;
+      std::ifstream ifs{path};
+      std::string line;
+      while (std::getline(ifs, line)) {
+        auto name_pos = line.find("\"name\": \"");
+        auto mean_pos = line.find("\"mean\": ");
+        if (name_pos == std::string::npos || mean_pos == std::string::npos) {
+          continue;
+        }
+        std::string name;
+        for (auto pos = name_pos + 9; pos < line.size() && line[pos] != '"';
+             ++pos) {
+          if (line[pos] == '\\') ++pos;
+          name += line[pos];
+        }
+        baseline[name] = std::strtod(line.c_str() + mean_pos + 8, nullptr);
+      }
+      return baseline;
+    }
+  }  // namespace
+
+  options_t parse_args(int argc, char* argv[], options_t options) {
+    for (int idx{1}; idx < argc; ++idx) {
+      std::string_view arg{argv[idx]};
+      auto value = [&] { return std::atoi(argv[idx] + 2); };
+      if (arg == "--json" && idx + 1 < argc) {
+        options.json_path = argv[++idx];
+      } else if (arg == "--baseline" && idx + 1 < argc) {
+        options.baseline_path = argv[++idx];
+      } else if (arg == "-q") {
+        options.quiet = true;
+      } else if (arg == "--no-allocs") {
+        options.no_allocs = true;
+      } else if (arg.starts_with("-i")) {
+        options.iters = std::max(1, value());
+      } else if (arg.starts_with("-w")) {
+        options.warmup = std::max(0, value());
+      } else if (arg.starts_with("-r")) {
+        options.reps = std::max(1, value());
+      } else if (arg.starts_with("-c")) {
+        options.cpu = value();
+      } else if (arg.starts_with("-s")) {
+        options.sample_every = std::max(1, value());
+      } else if (arg.starts_with("-t")) {
+        options.threshold = std::atof(argv[idx] + 2);
+      } else {
+        std::cerr << "unknown option: " << arg << std::endl
+                  << "usage: " << argv[0]
+                  << " [-i<iters>] [-w<warmup>] [-r<reps>] [-c<cpu>]"
+                     " [-s<sample_every>] [-t<threshold%>] [-q]"
+                     " [--no-allocs] [--json <path>] [--baseline <path>]"
+                  << std::endl;
+        std::exit(2);
+      }
+    }
+    return options;
+  }
+
+  harness_t::harness_t(options_t options) : options_(std::move(options)) {
+    if ((options_.cpu >= 0) && !pin_to_cpu(options_.cpu)) {
+      std::cerr << "failed to pin to cpu " << options_.cpu << std::endl;
+    }
+  }
+
+  stats_t harness_t::record(std::string_view name, int iters,
+      std::int64_t units, std::vector<double>& rep_ns,
+      std::vector<double>& samples, alloc_counts_t allocs) {
+    stats_t stats{.name = std::string{name}, .iters{iters}, .units{units},
+        .reps{(int)rep_ns.size()}};
+    auto per_unit = [units](double ns) { return ns / (double)units; };
+    stats.min = per_unit(*std::min_element(rep_ns.begin(), rep_ns.end()));
+    stats.max = per_unit(*std::max_element(rep_ns.begin(), rep_ns.end()));
+    double sum{};
+    for (auto ns : rep_ns) sum += per_unit(ns);
+    stats.mean = sum / (double)rep_ns.size();
+    double sq_sum{};
+    for (auto ns : rep_ns) {
+      auto diff = per_unit(ns) - stats.mean;
+      sq_sum += diff * diff;
+    }
+    stats.stddev = std::sqrt(sq_sum / (double)rep_ns.size());
+    std::sort(samples.begin(), samples.end());
+    stats.p50 = percentile(samples, 50.0);
+    stats.p99 = percentile(samples, 99.0);
+    stats.p999 = percentile(samples, 99.9);
+    stats.samples = samples.size();
+    const auto total_units = (double)units * (double)rep_ns.size();
+    stats.allocs = (double)allocs.allocs / total_units;
+    stats.alloc_bytes = (double)allocs.bytes / total_units;
+
+    if (!options_.quiet) {
+      std::cerr << std::fixed << std::setprecision(1) << stats.name << ": "
+                << stats.mean << " ns/unit (min " << stats.min << ", max "
+                << stats.max << ", stddev " << stats.stddev << "), p50 "
+                << stats.p50 << " p99 " << stats.p99 << " p999 "
+                << stats.p999 << " ns/op (" << stats.reps << " x "
+                << stats.iters << " ops, " << stats.units << " units)";
+      if (counting_allocs()) {
+        std::cerr << std::setprecision(2) << ", " << stats.allocs
+                  << " allocs/unit, " << stats.alloc_bytes << " bytes/unit";
+      }
+      std::cerr << std::endl;
+    }
+    results_.push_back(stats);
+    return stats;
+  }
+
+  void harness_t::fail(std::string_view name, std::string_view what) {
+    ++failures_;
+    std::cerr << name << ": " << what << " FAILED" << std::endl;
+  }
+
+  int harness_t::finish() {
+    const int alloc_rc = options_.no_allocs ? check_no_allocs(results_) : 0;
+    const int rc = failures_ ? 1 : alloc_rc;
+    if (!options_.json_path.empty()) {
+      std::ofstream ofs{options_.json_path};
+      write_json(ofs, results_);
+      if (!ofs) {
+        std::cerr << "failed to write " << options_.json_path << std::endl;
+        return 2;
+      }
+    }
+    if (options_.baseline_path.empty()) return rc;
+
+    auto baseline = read_baseline(options_.baseline_path);
+    int regressions{};
+    for (const auto& r : results_) {
+      auto it = baseline.find(r.name);
+      if (it == baseline.end() || it->second <= 0.0) {
+        std::cerr << r.name << ": no baseline" << std::endl;
+        continue;
+      }
+      auto pct = (r.mean - it->second) / it->second * 100.0;
+      bool regressed = pct > options_.threshold;
+      regressions += regressed;
+      std::cerr << std::fixed << std::setprecision(1) << r.name << ": "
+                << it->second << " -> " << r.mean << " ns/unit ("
+                << std::showpos << pct << std::noshowpos << "%)"
+                << (regressed ? " REGRESSION" : "") << std::endl;
+    }
+    return regressions ? 1 : rc;
+  }
+}  // namespace bench
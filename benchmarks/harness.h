@@ -0,0 +1,158 @@
+// harness.h
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace bench {
+  struct options_t {
+    int iters{1};
+    int warmup{0};
+    int reps{1};
+    int cpu{-1};            // pin to this cpu; -1 = don't pin
+    int sample_every{64};   // time every Nth op individually
+    double threshold{5.0};  // regression threshold, percent
+    bool quiet{};
+    bool no_allocs{};       // fail if a timed op allocates; see alloc_counts()
+    std::string json_path{};
+    std::string baseline_path{};
+  };
+
+  // Parse command line options over the supplied defaults:
+  //   -i<iters> -w<warmup> -r<reps> -c<cpu> -s<sample_every> -t<threshold>
+  //   -q  --no-allocs  --json <path>  --baseline <path>
+  options_t parse_args(int argc, char* argv[], options_t defaults);
+
+  struct alloc_counts_t {
+    std::uint64_t allocs{};
+    std::uint64_t bytes{};
+  };
+
+  // Allocations made through the global operator new so far. They are
+  // counted only in a benchmark that links the alloc_count library, which
+  // replaces operator new; counting_allocs() says whether this one does.
+  bool counting_allocs();
+  alloc_counts_t alloc_counts();
+
+  namespace detail {
+    // updated by alloc_count.cpp
+    extern constinit std::atomic<std::uint64_t> num_allocs;
+    extern constinit std::atomic<std::uint64_t> num_alloc_bytes;
+    extern constinit std::atomic<bool> alloc_counting;
+  }  // namespace detail
+
+  struct stats_t {
+    std::string name{};
+    std::int64_t iters{};
+    std::int64_t units{};  // per rep
+    int reps{};
+    // ns per unit, over reps
+    double mean{};
+    double min{};
+    double max{};
+    double stddev{};
+    // allocations per unit, over reps, if counting_allocs()
+    double allocs{};
+    double alloc_bytes{};
+    // sampled ns per op
+    double p50{};
+    double p99{};
+    double p999{};
+    std::size_t samples{};
+  };
+
+  // bench::harness_t
+  //
+  // Runs each op warmup times untimed, then reps timed repetitions of
+  // iters ops. Every sample_every'th op is also timed individually for
+  // latency percentiles. An op may return the number of units of work it
+  // did (e.g. messages in a batch); ns/unit is reported, and percentiles
+  // are per op. run() returns a copy of the stats it records.
+  class harness_t {
+  public:
+    explicit harness_t(options_t options);
+
+    const auto& options() const { return options_; }
+
+    template <typename OpFn>
+    stats_t run(std::string_view name, OpFn&& op) {
+      return run(name, options_.iters, std::forward<OpFn>(op));
+    }
+
+    template <typename OpFn>
+    stats_t run(std::string_view name, int iters, OpFn&& op) {
+      using clock = std::chrono::steady_clock;
+      int iter{};
+      for (; iter < options_.warmup; ++iter) {
+        invoke(op, iter);
+      }
+      // reserved up front, so the harness doesn't allocate while counting
+      std::vector<double> rep_ns;
+      rep_ns.reserve(options_.reps);
+      std::vector<double> samples;
+      const auto sample_every = std::max(1, options_.sample_every);
+      samples.reserve((std::size_t)(iters / sample_every + 1) * options_.reps);
+      const auto start_allocs = alloc_counts();
+      std::int64_t units{};
+      for (int rep{}; rep < options_.reps; ++rep) {
+        units = 0;
+        auto start = clock::now();
+        for (int idx{}; idx < iters; ++idx, ++iter) {
+          if (idx % sample_every) {
+            units += invoke(op, iter);
+          } else {
+            auto op_start = clock::now();
+            units += invoke(op, iter);
+            samples.push_back(ns(clock::now() - op_start));
+          }
+        }
+        rep_ns.push_back(ns(clock::now() - start));
+      }
+      const auto end_allocs = alloc_counts();
+      return record(name, iters, units, rep_ns, samples,
+          {end_allocs.allocs - start_allocs.allocs,
+              end_allocs.bytes - start_allocs.bytes});
+    }
+
+    // Report that benchmark name produced a wrong result, as what;
+    // finish() then fails.
+    void fail(std::string_view name, std::string_view what);
+
+    // Print a summary, write json and compare against the baseline, if
+    // requested. Returns a process exit code: non-zero on regression or
+    // failure, or with --no-allocs, if any timed op allocated.
+    int finish();
+
+  private:
+    template <typename OpFn>
+    static std::int64_t invoke(OpFn& op, int iter) {
+      if constexpr (std::is_void_v<std::invoke_result_t<OpFn&, int>>) {
+        op(iter);
+        return 1;
+      } else {
+        return (std::int64_t)op(iter);
+      }
+    }
+
+    static double ns(std::chrono::steady_clock::duration d) {
+      return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(d)
+          .count();
+    }
+
+    stats_t record(std::string_view name, int iters,
+        std::int64_t units, std::vector<double>& rep_ns,
+        std::vector<double>& samples, alloc_counts_t allocs);
+
+    options_t options_;
+    std::vector<stats_t> results_;
+    int failures_{};
+  };  // harness_t
+}  // namespace bench
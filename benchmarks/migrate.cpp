@@ -0,0 +1,111 @@
+// migrate.cpp
+//
+// Moving a live txn tree between contexts with context_t::rebind_txn().
+// The nested benchmark's outer/inner txn tree is rebound to the other of
+// two contexts after every message, so that it moves both while idle and
+// while the outer txn awaits the inner one. Measured with each context
+// running the tree as its own, and with the tree routed by txn id in two
+// multi-txn contexts; then handed between threads. Every out msg is
+// checked.
+
+#include <array>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "harness.h"
+#include "nested.h"
+
+namespace migrate {
+  using namespace nested;
+  using task_type = nested::txn::task_t<context_t>;
+
+  auto make_task(context_t& context) {
+    return cope::txn::basic_handler<nested::txn::task_t,
+        outer::txn::manager_t, context_t>(context, kOuterTxnId);
+  }
+
+  struct run_t {
+    std::array<context_t, 2> contexts{};
+    task_type task{make_task(contexts[0])};
+    int current{};
+    int errors{};
+
+    context_t& context() { return contexts[current]; }
+
+    void send(int iter) {
+      outer::txn::send_next(task, iter);
+      errors += !outer::txn::check_out(context().out(), iter);
+    }
+
+    void send_routed(int iter) {
+      outer::txn::routed_task_t routed{task, &context(), kOuterTxnId};
+      outer::txn::send_next(routed, iter);
+      errors += !outer::txn::check_out(context().out(), iter);
+    }
+
+    void rebind() {
+      current ^= 1;
+      if (context().rebind_txn(task.handle()).failed()) ++errors;
+    }
+
+    void report(bench::harness_t& harness, const char* name) {
+      if (errors) harness.fail(name, std::to_string(errors) + " errors");
+    }
+  };
+
+  void run(bench::harness_t& harness) {
+    run_t run;
+    harness.run("nested (no rebind)", [&run](int iter) { run.send(iter); });
+    run.report(harness, "nested (no rebind)");
+  }
+
+  void run_rebind(bench::harness_t& harness) {
+    run_t run;
+    harness.run("nested (rebind every msg)", [&run](int iter) {
+      run.send(iter);
+      run.rebind();
+    });
+    run.report(harness, "nested (rebind every msg)");
+  }
+
+  void run_routed_rebind(bench::harness_t& harness) {
+    run_t run;
+    run.context().add_txn(run.task.handle());
+    harness.run("nested (routed, rebind every msg)", [&run](int iter) {
+      run.send_routed(iter);
+      run.rebind();
+    });
+    run.report(harness, "nested (routed, rebind every msg)");
+  }
+
+  // Each context is driven by its own thread; the tree is handed to the
+  // other thread after every kBurst messages.
+  void run_threads(bench::harness_t& harness, int handoffs) {
+    constexpr int kBurst{100};
+    run_t run;
+    int iter{};
+    for (int handoff{}; handoff < handoffs; ++handoff) {
+      std::jthread worker{[&run, &iter] {
+        for (int end{iter + kBurst}; iter < end; ++iter) run.send(iter);
+        run.rebind();
+      }};
+    }
+    run.report(harness, "nested (threads)");
+    std::cerr << "nested (threads): " << handoffs << " handoffs" << std::endl;
+  }
+}  // namespace migrate
+
+int main(int argc, char* argv[]) {
+#ifndef NDEBUG
+  cope::log::enable();
+  bench::options_t defaults{.iters{6}};
+#else
+  bench::options_t defaults{.iters{3'000'000}, .warmup{30'000}, .reps{5}};
+#endif
+  bench::harness_t harness{bench::parse_args(argc, argv, defaults)};
+  migrate::run(harness);
+  migrate::run_rebind(harness);
+  migrate::run_routed_rebind(harness);
+  migrate::run_threads(harness, harness.options().iters < 1000 ? 2 : 1000);
+  return harness.finish();
+}
@@ -0,0 +1,198 @@
+// multi_await.cpp
+//
+// A txn that awaits one nested txn per start, through a manager with a
+// single awaiter type and through one whose awaiter_types lists several
+// (a variant_awaitable). Each op is the outer start_txn plus the message
+// that completes the nested txn. The nested txn is chosen per op, in turn,
+// or, in the "always a" case, is always the first, so that the op does
+// the same work as with a single awaiter type.
+
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include "cope.h"
+#include "cope_handler/basic.h"
+#include "harness.h"
+
+namespace multi {
+  constexpr auto kOuterTxnId{ cope::txn::make_id(100) };
+  constexpr auto kATxnId{ cope::txn::make_id(200) };
+  constexpr auto kBTxnId{ cope::txn::make_id(300) };
+  constexpr auto kCTxnId{ cope::txn::make_id(400) };
+
+  struct out_msg_t {
+    int value;
+  };
+
+  namespace txn {
+    struct state_t {
+      int value;
+      int step;
+    };
+  }  // namespace txn
+
+  // the nested txns; each yields once, then completes
+  template <int N>
+  struct inner {
+    struct data_t {
+      int value;
+    };
+
+    using start_txn_t = cope::msg::start_txn_t<data_t, txn::state_t>;
+
+    struct types {
+      using in_tuple_t = std::tuple<start_txn_t, data_t>;
+      using out_tuple_t = std::tuple<out_msg_t>;
+    };
+
+    template <typename ContextT>
+    using task_t = cope::txn::task_t<data_t, txn::state_t, ContextT>;
+
+    template <typename ContextT>
+    struct manager_t : cope::txn::basic_manager_t<txn::state_t, ContextT> {
+      using base = typename manager_t::basic_manager_t;
+
+      manager_t(ContextT&) {}
+
+      cope::expected_operation update_state(
+          const ContextT&, txn::state_t& state) {
+        return state.step++ ? cope::operation::complete
+                            : cope::operation::yield;
+      }
+
+      base::yield_msg_type get_yield_msg(const txn::state_t&) {
+        return out_msg_t{N};
+      }
+    };  // struct manager_t
+  };  // struct inner
+
+  using a = inner<0>;
+  using b = inner<1>;
+  using c = inner<2>;
+
+  namespace outer {
+    struct data_t {
+      int value;
+    };
+
+    using start_txn_t = cope::msg::start_txn_t<data_t, txn::state_t>;
+
+    struct types {
+      using in_tuple_t = std::tuple<start_txn_t, data_t>;
+      using out_tuple_t = std::tuple<out_msg_t>;
+    };
+  }  // namespace outer
+
+  using type_bundle_t = cope::msg::type_bundle_t<outer::types, a::types,
+      b::types, c::types>;
+  using context_t = cope::txn::context_t<type_bundle_t>;
+
+  template <typename InnerT>
+  using awaiter_t =
+      cope::txn::start_awaitable<typename InnerT::template task_t<context_t>>;
+
+  namespace outer {
+    template <typename ContextT>
+    using task_t = cope::txn::task_t<data_t, txn::state_t, ContextT>;
+
+    // Awaits one nested txn, then completes. With more than one InnerT,
+    // the nested txn is chosen by the start state's value.
+    template <typename... InnerTs>
+    struct manager_base_t {
+      template <typename ContextT>
+      struct manager_t
+          : cope::txn::basic_manager_t<txn::state_t, ContextT> {
+        using awaiter_types = std::tuple<awaiter_t<InnerTs>...>;
+        using awaiter_type =
+            cope::txn::detail::awaiter_for_t<awaiter_types>;
+
+        manager_t(ContextT& context)
+            : inner_tasks_(make_task<InnerTs>(context)...) {}
+
+        cope::expected_operation update_state(
+            const ContextT&, txn::state_t& state) {
+          return state.step++ ? cope::operation::complete
+                              : cope::operation::await;
+        }
+
+        cope::result_t get_awaiter(ContextT&, const txn::state_t& state,
+            awaiter_type& awaiter) {
+          choose<0>(state.value % sizeof...(InnerTs), awaiter);
+          return {};
+        }
+
+      private:
+        template <typename InnerT>
+        static auto make_task(ContextT& context) {
+          using task_type = typename InnerT::template task_t<ContextT>;
+          constexpr auto id = std::is_same_v<InnerT, a> ? kATxnId
+                              : std::is_same_v<InnerT, b> ? kBTxnId
+                                                          : kCTxnId;
+          return std::unique_ptr<task_type>(new task_type(
+              cope::txn::basic_handler<InnerT::template task_t,
+                  InnerT::template manager_t>(context, id)));
+        }
+
+        template <std::size_t I>
+        void choose(std::size_t idx, awaiter_type& awaiter) {
+          if constexpr (I < sizeof...(InnerTs)) {
+            if (idx != I) return choose<I + 1>(idx, awaiter);
+            using inner_type =
+                std::tuple_element_t<I, std::tuple<InnerTs...>>;
+            auto& task = *std::get<I>(inner_tasks_);
+            typename inner_type::data_t msg{I};
+            txn::state_t state{I, 0};
+            if constexpr (sizeof...(InnerTs) > 1) {
+              // constructed in place in the empty variant_awaitable
+              awaiter.template emplace<awaiter_t<inner_type>>(task.handle(),
+                  msg, state);
+            } else {
+              awaiter = awaiter_t<inner_type>{task.handle(), msg, state};
+            }
+          }
+        }
+
+        template <typename InnerT>
+        using task_ptr = std::unique_ptr<
+            typename InnerT::template task_t<ContextT>>;
+
+        std::tuple<task_ptr<InnerTs>...> inner_tasks_;
+      };  // struct manager_t
+    };  // struct manager_base_t
+  }  // namespace outer
+
+  template <typename... InnerTs>
+  void run(bench::harness_t& harness, const char* name, bool rotate = true) {
+    context_t context{};
+    auto task{cope::txn::basic_handler<outer::task_t,
+        outer::manager_base_t<InnerTs...>::template manager_t>(
+        context, kOuterTxnId)};
+    harness.run(name, [&task, rotate](int iter) {
+      const auto value = rotate ? iter : 0;
+      const auto idx = value % sizeof...(InnerTs);
+      [[maybe_unused]] const auto& out = task.send_msg(
+          outer::start_txn_t{outer::data_t{0}, txn::state_t{value, 0}});
+      // the message type of the nested txn that was chosen
+      idx == 0   ? (void)task.send_msg(typename a::data_t{1})
+      : idx == 1 ? (void)task.send_msg(typename b::data_t{1})
+                 : (void)task.send_msg(typename c::data_t{1});
+    });
+  }
+}  // namespace multi
+
+int main(int argc, char* argv[]) {
+#ifndef NDEBUG
+  cope::log::enable();
+  bench::options_t defaults{.iters{3}};
+#else
+  bench::options_t defaults{.iters{3'000'000}, .warmup{30'000}, .reps{5}};
+#endif
+  bench::harness_t harness{bench::parse_args(argc, argv, defaults)};
+  multi::run<multi::a>(harness, "await (1 awaiter type)");
+  multi::run<multi::a, multi::b>(harness, "await (2 awaiter types)");
+  multi::run<multi::a, multi::b, multi::c>(
+      harness, "await (3 awaiter types)");
+  multi::run<multi::a, multi::b, multi::c>(
+      harness, "await (3 awaiter types, always a)", false);
+  return harness.finish();
+}
@@ -0,0 +1,201 @@
+// mux.cpp
+//
+// Many long-running txns driven from one thread: each message goes to a
+// pseudo-randomly chosen session. Compares routing by txn id through one
+// multi-txn context (context_t::send_msg(id, msg)) with a context per
+// session, at 1, 1k and 100k sessions, but no more than 10 per op. Also
+// checks a context's own txn tree alongside a routed one.
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <tuple>
+#include <variant>
+#include <vector>
+#include "cope.h"
+#include "cope_handler/basic.h"
+#include "harness.h"
+#include "nested.h"
+
+namespace mux {
+  namespace msg {
+    struct data_t {
+      int value;
+    };
+
+    struct out_t {
+      int total;
+    };
+  }  // namespace msg
+
+  namespace txn {
+    struct state_t {
+      int total;
+    };
+  }  // namespace txn
+
+  namespace msg {
+    using start_txn_t = cope::msg::start_txn_t<data_t, txn::state_t>;
+
+    struct types {
+      using in_tuple_t = std::tuple<start_txn_t, data_t>;
+      using out_tuple_t = std::tuple<out_t>;
+    };
+  }  // namespace msg
+
+  using type_bundle_t = cope::msg::type_bundle_t<msg::types>;
+  using context_t = cope::txn::context_t<type_bundle_t>;
+
+  namespace txn {
+    template <typename ContextT>
+    using task_t = cope::txn::task_t<msg::data_t, state_t, ContextT>;
+
+    using task_type = task_t<context_t>;
+
+    // Sums the values it receives, yielding the running total; never
+    // completes.
+    template <typename ContextT>
+    struct manager_t : cope::txn::basic_manager_t<state_t, ContextT> {
+      using base = typename manager_t::basic_manager_t;
+
+      manager_t(ContextT&) {}
+
+      cope::expected_operation update_state(const ContextT& context,
+          state_t& state) {
+        if (auto data = cope::msg::get_if<msg::data_t>(context.in())) {
+          state.total += data->value;
+        }
+        return cope::operation::yield;
+      }
+
+      base::yield_msg_type get_yield_msg(const state_t& state) {
+        return msg::out_t{state.total};
+      }
+    };  // struct manager_t
+
+    auto make_task(context_t& context, int session) {
+      return std::unique_ptr<task_type>(
+          new task_type(cope::txn::basic_handler<task_t, manager_t>(
+              context, cope::txn::make_id(session))));
+    }
+  }  // namespace txn
+
+  // the session each op sends to
+  std::vector<int> make_order(int num_sessions) {
+    std::vector<int> order(1 << 16);
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<int> dist{0, num_sessions - 1};
+    for (auto& session : order) session = dist(gen);
+    return order;
+  }
+
+  constexpr std::size_t kOrderMask{(1 << 16) - 1};
+
+  void run_mux(bench::harness_t& harness, int num_sessions) {
+    context_t context{};
+    std::vector<std::unique_ptr<txn::task_type>> tasks;
+    for (int session{}; session < num_sessions; ++session) {
+      tasks.push_back(txn::make_task(context, session));
+      context.add_txn(tasks.back()->handle());
+      [[maybe_unused]] const auto& out = context.send_msg(
+          cope::txn::make_id(session), msg::start_txn_t{{0}, {0}});
+    }
+    const auto order = make_order(num_sessions);
+    const auto name = "mux (" + std::to_string(num_sessions) + " sessions)";
+    std::cerr << name << ": " << sizeof(context_t::slot_t)
+              << " bytes/session" << std::endl;
+    harness.run(name, [&context, &order](int iter) {
+      const auto id = cope::txn::make_id(order[iter & kOrderMask]);
+      [[maybe_unused]] const auto& out =
+          context.send_msg(id, msg::data_t{1});
+    });
+    for (int session{}; session < num_sessions; ++session) {
+      context.remove_txn(cope::txn::make_id(session));
+    }
+  }
+
+  void run_contexts(bench::harness_t& harness, int num_sessions) {
+    std::vector<std::unique_ptr<context_t>> contexts;
+    std::vector<std::unique_ptr<txn::task_type>> tasks;
+    for (int session{}; session < num_sessions; ++session) {
+      contexts.push_back(std::make_unique<context_t>());
+      tasks.push_back(txn::make_task(*contexts.back(), session));
+      [[maybe_unused]] const auto& out =
+          tasks.back()->send_msg(msg::start_txn_t{{0}, {0}});
+    }
+    const auto order = make_order(num_sessions);
+    const auto name =
+        "contexts (" + std::to_string(num_sessions) + " sessions)";
+    std::cerr << name << ": " << sizeof(context_t) << " bytes/session"
+              << std::endl;
+    harness.run(name, [&tasks, &order](int iter) {
+      auto& task = *tasks[order[iter & kOrderMask]];
+      [[maybe_unused]] const auto& out = task.send_msg(msg::data_t{1});
+    });
+  }
+
+  // The context's own nested txn tree and a routed one, sent messages in
+  // turn: the own tree through its task, the routed one by txn id. Every
+  // out msg is checked.
+  void run_mixed(bench::harness_t& harness) {
+    using nested::outer::txn::check_out;
+    using nested::outer::txn::send_next;
+    constexpr auto kRoutedTxnId{cope::txn::make_id(1)};
+    nested::context_t context{};
+    auto make_task = [&context](cope::txn::id_t id) {
+      return cope::txn::basic_handler<nested::txn::task_t,
+          nested::outer::txn::manager_t, nested::context_t>(context, id);
+    };
+    auto own = make_task(nested::kOuterTxnId);
+    auto routed = make_task(kRoutedTxnId);
+    context.add_txn(routed.handle());
+    nested::outer::txn::routed_task_t routed_task{
+        routed, &context, kRoutedTxnId};
+    const auto name = "mux (own and routed trees)";
+    // a message for an id that isn't routed touches neither tree
+    const auto& miss =
+        context.send_msg(cope::txn::make_id(2), nested::msg::data_t{1});
+    if (!std::holds_alternative<std::monostate>(miss)
+        || (context.route_result().code
+            != cope::result_code::e_unexpected_txn_id)) {
+      harness.fail(name, "unrouted id");
+    }
+    int errors{};
+    harness.run(name, [&](int iter) {
+      if (iter % 2) {
+        send_next(routed_task, iter / 2);
+      } else {
+        send_next(own, iter / 2);
+      }
+      errors += !check_out(context.out(), iter / 2);
+    });
+    context.remove_txn(kRoutedTxnId);
+    if (errors) harness.fail(name, std::to_string(errors) + " errors");
+  }
+}  // namespace mux
+
+int main(int argc, char* argv[]) {
+#ifndef NDEBUG
+  cope::log::enable();
+  bench::options_t defaults{.iters{4}};
+#else
+  bench::options_t defaults{.iters{2'000'000}, .warmup{20'000}, .reps{5}};
+#endif
+  bench::harness_t harness{bench::parse_args(argc, argv, defaults)};
+  mux::run_mixed(harness);
+  // a short run, such as ctest's, sends too few messages to need 100k
+  // sessions
+  const auto max_sessions = 10 * std::max(1, harness.options().iters);
+  int last_sessions{};
+  for (int num_sessions : {1, 1'000, 100'000}) {
+    num_sessions = std::min(num_sessions, max_sessions);
+    if (num_sessions == last_sessions) continue;
+    last_sessions = num_sessions;
+    mux::run_mux(harness, num_sessions);
+    mux::run_contexts(harness, num_sessions);
+  }
+  return harness.finish();
+}
@@ -0,0 +1,145 @@
+// proxy.cpp
+//
+// Large-table throughput with a table delivered by value, by reference
+// (proxy::raw_ptr_t) and by ownership (proxy::unique_ptr_t). Only by
+// value is the table copied per op.
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <variant>
+#include "cope.h"
+#include "cope_handler/basic.h"
+#include "cope_proxy.h"
+#include "harness.h"
+
+namespace proxy {
+  constexpr auto kTxnId{ cope::txn::make_id(100) };
+
+  namespace msg {
+    struct row_t {
+      int name_id;
+      int price;
+      bool listed;
+      bool selected;
+    };
+
+    template <std::size_t N>
+    struct table_t {
+      std::array<row_t, N> rows;
+    };
+
+    struct click_row_t {
+      int row;
+    };
+  }  // namespace msg
+
+  namespace txn {
+    struct state_t {
+      int name_id;
+      int price;
+      int matches;
+    };
+  }  // namespace txn
+
+  // MsgT is a table_t, or a raw_ptr_t/unique_ptr_t proxy for one
+  template <typename TableT, typename MsgT>
+  struct bench_t {
+    using start_txn_t = cope::msg::start_txn_t<MsgT, txn::state_t>;
+
+    struct types {
+      using in_tuple_t = std::tuple<start_txn_t, MsgT>;
+      using out_tuple_t = std::tuple<msg::click_row_t>;
+    };
+
+    using type_bundle_t = cope::msg::type_bundle_t<types>;
+    using context_type = cope::txn::context_t<type_bundle_t>;
+
+    template <typename ContextT>
+    using task_t = cope::txn::task_t<MsgT, txn::state_t, ContextT>;
+
+    template <typename ContextT>
+    struct manager_t : cope::txn::basic_manager_t<txn::state_t, ContextT> {
+      manager_t(ContextT&) {}
+
+      cope::expected_operation update_state(
+          const ContextT& context, txn::state_t& state) {
+        auto table = cope::msg::get_if<TableT>(context.in());
+        if (!table) {
+          return std::unexpected(cope::result_code::e_unexpected_msg_type);
+        }
+        for (const auto& row : table->rows) {
+          if ((row.name_id == state.name_id) && (row.price != state.price)) {
+            ++state.matches;
+          }
+        }
+        return cope::operation::complete;
+      }
+    };
+
+    // By ownership, the table is allocated once and moved back out of
+    // context.in() after each send, so that each op hands over only the
+    // pointer.
+    static void run(bench::harness_t& harness, const std::string& name,
+        const TableT& table, int iters) {
+      context_type context{};
+      auto task{cope::txn::basic_handler<task_t, manager_t>(context, kTxnId)};
+      if constexpr (std::is_same_v<MsgT, cope::proxy::unique_ptr_t<TableT>>) {
+        auto owned = std::make_unique<TableT>(table);
+        harness.run(name, iters, [&task, &context, &owned](int) {
+          auto txn_start =
+              start_txn_t{MsgT{std::move(owned)}, txn::state_t{1, 2, 0}};
+          [[maybe_unused]] const auto& r = task.send_msg(std::move(txn_start));
+          owned = std::get<MsgT>(context.in()).get_moveable();
+        });
+        if (!owned) harness.fail(name, "table not returned");
+      } else {
+        // a copy of the table by value, or a pointer to it by reference
+        harness.run(name, iters, [&task, &table](int) {
+          auto txn_start = start_txn_t{MsgT{table}, txn::state_t{1, 2, 0}};
+          [[maybe_unused]] const auto& r = task.send_msg(std::move(txn_start));
+        });
+      }
+    }
+  };  // bench_t
+
+  template <std::size_t N>
+  void run_all(bench::harness_t& harness, int iters) {
+    using table_type = msg::table_t<N>;
+    // heap allocated; large tables would overflow the stack
+    auto table = std::make_unique<table_type>();
+    for (std::size_t idx{}; idx < N; ++idx) {
+      table->rows[idx] = {(int)(idx % 4), (int)(idx % 3), !(idx % 2), false};
+    }
+    using value_bench = bench_t<table_type, table_type>;
+    using raw_ptr_bench =
+        bench_t<table_type, cope::proxy::raw_ptr_t<table_type>>;
+    using unique_ptr_bench =
+        bench_t<table_type, cope::proxy::unique_ptr_t<table_type>>;
+
+    auto name = [](const char* mode) {
+      return std::string{"proxy "} + mode + " (" + std::to_string(N)
+             + " rows)";
+    };
+    value_bench::run(harness, name("value"), *table, iters);
+    raw_ptr_bench::run(harness, name("raw_ptr"), *table, iters);
+    unique_ptr_bench::run(harness, name("unique_ptr"), *table, iters);
+  }
+}  // namespace proxy
+
+int main(int argc, char* argv[]) {
+#ifndef NDEBUG
+  cope::log::enable();
+  bench::options_t defaults{.iters{10}};
+#else
+  bench::options_t defaults{.iters{200'000}, .warmup{1'000}, .reps{5}};
+#endif
+  bench::harness_t harness{bench::parse_args(argc, argv, defaults)};
+  auto iters = harness.options().iters;
+  proxy::run_all<16>(harness, iters);
+  proxy::run_all<256>(harness, iters);
+  proxy::run_all<4096>(harness, std::max(1, iters / 10));
+  return harness.finish();
+}
@@ -0,0 +1,218 @@
+// shm.cpp
+//
+// Two-process shm::ring transport. The parent plays the capture process:
+// it sends row tables over one ring to a forked child, which drives a
+// task with shm::serve and sends each yielded click message back on a
+// second ring. Measures round-trip latency, one message in flight, and
+// pipelined throughput, with the ends waiting on futexes and, on machines
+// with more than one cpu, busy-polling.
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <variant>
+#include <vector>
+#include "cope.h"
+#include "cope_handler/basic.h"
+#include "cope_shm.h"
+#include "harness.h"
+
+namespace shm_bench {
+  constexpr auto kTxnId{ cope::txn::make_id(100) };
+  constexpr std::size_t kRingCapacity{1 << 20};
+  constexpr int kNumRows{15};
+  constexpr int kBatch{256};
+
+  namespace msg {
+    struct row_t {
+      std::string item_name;
+      int item_price;
+      bool item_listed;
+      bool selected;
+    };
+
+    struct rows_t {
+      std::vector<row_t> rows;
+    };
+
+    struct click_t {
+      int row;
+    };
+  }  // namespace msg
+
+  namespace txn {
+    struct state_t {
+      int clicks;
+    };
+  }  // namespace txn
+
+  namespace msg {
+    using start_txn_t = cope::msg::start_txn_t<rows_t, txn::state_t>;
+
+    struct types {
+      using in_tuple_t = std::tuple<start_txn_t, rows_t>;
+      using out_tuple_t = std::tuple<click_t>;
+    };
+  }  // namespace msg
+
+  using type_bundle_t = cope::msg::type_bundle_t<msg::types>;
+  using context_t = cope::txn::context_t<type_bundle_t>;
+}  // namespace shm_bench
+
+// declared names, so that frame tags are the same in every build
+template <>
+struct cope::msg::info_t<shm_bench::msg::start_txn_t> {
+  static constexpr std::string_view name{"shm_bench::start_txn"};
+};
+
+template <>
+struct cope::msg::info_t<shm_bench::msg::rows_t> {
+  static constexpr std::string_view name{"shm_bench::rows"};
+};
+
+template <>
+struct cope::msg::info_t<shm_bench::msg::click_t> {
+  static constexpr std::string_view name{"shm_bench::click"};
+};
+
+template <>
+struct cope::wire::codec_t<shm_bench::msg::row_t>
+    : cope::wire::fields_codec_t<&shm_bench::msg::row_t::item_name,
+          &shm_bench::msg::row_t::item_price,
+          &shm_bench::msg::row_t::item_listed,
+          &shm_bench::msg::row_t::selected> {};
+
+template <>
+struct cope::wire::codec_t<shm_bench::msg::rows_t>
+    : cope::wire::fields_codec_t<&shm_bench::msg::rows_t::rows> {};
+
+namespace shm_bench {
+  namespace shm = cope::shm;
+
+  namespace txn {
+    template <typename ContextT>
+    using task_t = cope::txn::task_t<msg::rows_t, state_t, ContextT>;
+
+    // Clicks the first selected row of every table; never completes.
+    template <typename ContextT>
+    struct manager_t : cope::txn::basic_manager_t<state_t, ContextT> {
+      using base = typename manager_t::basic_manager_t;
+
+      manager_t(ContextT&) {}
+
+      cope::expected_operation update_state(
+          const ContextT& context, state_t& state) {
+        const auto& rows = cope::msg::get_if<msg::rows_t>(context.in())->rows;
+        auto it = std::find_if(rows.begin(), rows.end(),
+            [](const msg::row_t& row) { return row.selected; });
+        state.clicks = (int)(it - rows.begin());
+        return cope::operation::yield;
+      }
+
+      base::yield_msg_type get_yield_msg(const state_t& state) {
+        return msg::click_t{state.clicks};
+      }
+    };  // struct manager_t
+  }  // namespace txn
+
+  msg::rows_t make_rows(int selected) {
+    msg::rows_t msg;
+    for (int idx{}; idx < kNumRows; ++idx) {
+      msg.rows.push_back({"magic beans", idx, false, idx == selected});
+    }
+    return msg;
+  }
+
+  struct rings_t {
+    shm::ring_t to_child;
+    shm::ring_t to_parent;
+  };
+
+  rings_t attach(const shm::segment_t& segment, bool create) {
+    auto to_child = static_cast<std::byte*>(segment.data());
+    auto to_parent = to_child + shm::ring_t::bytes_for(kRingCapacity);
+    if (create) {
+      return {shm::ring_t::create(to_child, kRingCapacity),
+          shm::ring_t::create(to_parent, kRingCapacity)};
+    }
+    return {shm::ring_t::attach(to_child), shm::ring_t::attach(to_parent)};
+  }
+
+  // the child process: drive a task from the to_child ring
+  [[noreturn]] void serve(const std::string& name, shm::wait_mode mode) {
+    auto segment = shm::segment_t::open(name);
+    auto rings = attach(segment, false);
+    shm::consumer_t in{rings.to_child};
+    shm::producer_t out{rings.to_parent};
+    context_t context{};
+    auto task{cope::txn::basic_handler<txn::task_t, txn::manager_t>(
+        context, kTxnId)};
+    shm::serve<context_t>(task, in, out, mode);
+    out.close();
+    std::_Exit(0);
+  }
+
+  void run(bench::harness_t& harness, shm::wait_mode mode,
+      const std::string& suffix) {
+    const auto name = "/cope_shm_bench_" + std::to_string(::getpid());
+    auto segment = shm::segment_t::create(
+        name, 2 * shm::ring_t::bytes_for(kRingCapacity));
+    auto rings = attach(segment, true);
+    const auto pid = ::fork();
+    if (!pid) serve(name, mode);
+
+    shm::producer_t out{rings.to_child};
+    shm::consumer_t in{rings.to_parent};
+    const auto rows = make_rows(kNumRows / 2);
+    out.send(msg::start_txn_t{rows, txn::state_t{}}, mode);
+    in.receive(mode);
+    in.release();
+
+    harness.run("round trip" + suffix, [&out, &in, &rows, mode](int) {
+      out.send(rows, mode);
+      [[maybe_unused]] auto reply = in.receive(mode);
+      in.release();
+    });
+
+    // keep up to kBatch messages in flight
+    harness.run("pipelined" + suffix,
+        std::max(1, harness.options().iters / kBatch),
+        [&out, &in, &rows, mode](int) {
+          int sent{};
+          int received{};
+          while (received < kBatch) {
+            while ((sent < kBatch) && out.try_send(rows)) ++sent;
+            // wait for one reply, then take all that have arrived
+            if (!in.receive(mode)) break;
+            for (++received; in.try_receive(); ++received) {}
+            in.release();
+          }
+          return kBatch;
+        });
+
+    out.close();
+    int status{};
+    ::waitpid(pid, &status, 0);
+  }
+}  // namespace shm_bench
+
+int main(int argc, char* argv[]) {
+  using namespace shm_bench;
+#ifndef NDEBUG
+  bench::options_t defaults{.iters{kBatch}};
+#else
+  bench::options_t defaults{.iters{200'000}, .warmup{2'000}, .reps{5}};
+#endif
+  bench::harness_t harness{bench::parse_args(argc, argv, defaults)};
+  run(harness, shm::wait_mode::wait, " (futex)");
+  // busy-polling ends starve each other on a single cpu
+  if (std::thread::hardware_concurrency() > 1) {
+    run(harness, shm::wait_mode::busy_poll, " (busy poll)");
+  }
+  return harness.finish();
+}
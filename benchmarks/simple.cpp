@@ -1,9 +1,11 @@
 // simple.cpp
 
-#include <chrono>
+#include <algorithm>
+#include <span>
+#include <vector>
 #include "cope.h"
 #include "cope_handler/basic.h"
-#include "log.h"
+#include "harness.h"
 
 namespace simple {
   constexpr auto kTxnId{ cope::txn::make_id(100) };
@@ -45,33 +47,65 @@ namespace simple {
     using manager_t = cope::txn::basic_manager_t<txn::state_t, ContextT>;
   }  // namespace txn
 
-  auto run(txn::task_t<app::context_type>& task, int num_iter) {
-    using namespace std::chrono;
-    auto start = high_resolution_clock::now();
-    msg::data_t msg{.value{1}};
-    for (int iter{}; iter < num_iter; ++iter) {
-      auto txn_start =
-          msg::start_txn_t{std::move(msg), txn::state_t{.value{iter}}};
-      [[maybe_unused]] const auto& r = task.send_msg(std::move(txn_start));
+  using task_type = txn::task_t<app::context_type>;
+
+  void send(task_type& task, int iter) {
+    auto txn_start =
+        msg::start_txn_t{msg::data_t{.value{1}}, txn::state_t{.value{iter}}};
+    [[maybe_unused]] const auto& r = task.send_msg(std::move(txn_start));
+  }
+
+  // A txn sent a message other than a start_txn_t fails with
+  // e_unexpected_msg_type; the next txn starts with a clean result.
+  void check_recovery(bench::harness_t& harness, task_type& task) {
+    using cope::result_code;
+    const auto name = "simple (recovery)";
+    [[maybe_unused]] const auto& out = task.send_msg(msg::data_t{.value{1}});
+    if (task.context().result().code != result_code::e_unexpected_msg_type) {
+      harness.fail(name, "non-start msg accepted");
+    }
+    send(task, 0);
+    if (task.context().result().code != result_code::s_ok) {
+      harness.fail(name, "txn after a failed one failed");
     }
-    auto end = high_resolution_clock::now();
-    return (double)duration_cast<nanoseconds>(end - start).count();
   }
+
+  struct batch_t {
+    static constexpr int kSize{256};
+
+    int send(task_type& task, int iter) {
+      for (int idx{}; idx < kSize; ++idx) {
+        msgs[idx] = msg::start_txn_t{
+            msg::data_t{.value{1}}, txn::state_t{.value{iter + idx}}};
+      }
+      task.send_msgs(std::span{msgs}, out.begin());
+      return kSize;
+    }
+
+    std::vector<msg::start_txn_t> msgs = std::vector<msg::start_txn_t>(kSize);
+    std::vector<app::context_type::out_msg_type> out =
+        std::vector<app::context_type::out_msg_type>(kSize);
+  };
 } // namespace simple
 
-int main() {
+int main(int argc, char* argv[]) {
 #ifndef NDEBUG
   cope::log::enable();
-  int num_iter{ 10 };
+  bench::options_t defaults{.iters{10}};
 #else
-  int num_iter{ 50'000'000 }; 
+  bench::options_t defaults{.iters{10'000'000}, .warmup{100'000}, .reps{5}};
 #endif
+  bench::harness_t harness{bench::parse_args(argc, argv, defaults)};
 
   using namespace simple;
-  double elapsed{};
   app::context_type context{};
   auto task{
       cope::txn::basic_handler<txn::task_t, txn::manager_t>(context, kTxnId)};
-  elapsed = run(task, num_iter);
-  log("simple", num_iter, elapsed);
+  check_recovery(harness, task);
+  harness.run("simple", [&task](int iter) { send(task, iter); });
+  batch_t batch;
+  harness.run("simple (batched)",
+      std::max(1, harness.options().iters / batch_t::kSize),
+      [&task, &batch](int iter) { return batch.send(task, iter); });
+  return harness.finish();
 }
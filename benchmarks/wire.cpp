@@ -0,0 +1,178 @@
+// wire.cpp
+//
+// wire::encode and wire::decode throughput for messages of increasing
+// encoding cost: a small trivially copyable message, a 128-byte one, a
+// string, and a vector of 15 rows of the shape sellitems sends. Each op
+// encodes or decodes a batch of kBatch frames of one message type; ns are
+// reported per message. The trivially copyable messages are also read in
+// place through wire::view. Also checks that a frame with a corrupt
+// vector count is rejected.
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <variant>
+#include <vector>
+#include "cope_msg.h"
+#include "cope_wire.h"
+#include "harness.h"
+
+namespace wire_bench {
+  constexpr int kBatch{64};
+
+  namespace msg {
+    struct point_t {
+      int x;
+      int y;
+    };
+
+    struct quote_t {
+      std::array<char, 64> symbol;
+      std::array<double, 8> prices;
+    };
+
+    struct note_t {
+      std::string text;
+    };
+
+    struct row_t {
+      std::string item_name;
+      int item_price;
+      bool item_listed;
+      bool selected;
+    };
+
+    struct rows_t {
+      std::vector<row_t> rows;
+    };
+
+    struct types {
+      using in_tuple_t = std::tuple<point_t, quote_t, note_t, rows_t>;
+      using out_tuple_t = std::tuple<point_t>;
+    };
+  }  // namespace msg
+
+  using type_bundle_t = cope::msg::type_bundle_t<msg::types>;
+  using msg_type = type_bundle_t::in_msg_type;
+}  // namespace wire_bench
+
+// declared names, so that frame tags are the same in every build
+template <>
+struct cope::msg::info_t<wire_bench::msg::point_t> {
+  static constexpr std::string_view name{"wire_bench::point"};
+};
+
+template <>
+struct cope::msg::info_t<wire_bench::msg::quote_t> {
+  static constexpr std::string_view name{"wire_bench::quote"};
+};
+
+template <>
+struct cope::msg::info_t<wire_bench::msg::note_t> {
+  static constexpr std::string_view name{"wire_bench::note"};
+};
+
+template <>
+struct cope::msg::info_t<wire_bench::msg::rows_t> {
+  static constexpr std::string_view name{"wire_bench::rows"};
+};
+
+template <>
+struct cope::wire::codec_t<wire_bench::msg::note_t>
+    : cope::wire::fields_codec_t<&wire_bench::msg::note_t::text> {};
+
+template <>
+struct cope::wire::codec_t<wire_bench::msg::row_t>
+    : cope::wire::fields_codec_t<&wire_bench::msg::row_t::item_name,
+          &wire_bench::msg::row_t::item_price,
+          &wire_bench::msg::row_t::item_listed,
+          &wire_bench::msg::row_t::selected> {};
+
+template <>
+struct cope::wire::codec_t<wire_bench::msg::rows_t>
+    : cope::wire::fields_codec_t<&wire_bench::msg::rows_t::rows> {};
+
+namespace wire_bench {
+  namespace wire = cope::wire;
+
+  msg::rows_t make_rows() {
+    msg::rows_t msg;
+    for (int idx{}; idx < 15; ++idx) {
+      msg.rows.push_back({idx % 3 ? "magic beans" : "magic balls", idx % 9,
+          (idx % 2) == 1, (idx % 4) == 0});
+    }
+    return msg;
+  }
+
+  template <typename T>
+  void run(bench::harness_t& harness, const std::string& name, const T& msg) {
+    wire::writer_t out;
+    for (int idx{}; idx < kBatch; ++idx) wire::encode(out, msg);
+    std::cerr << name << ": " << out.size() / kBatch << " bytes/frame"
+              << std::endl;
+
+    harness.run(name + " encode", [&out, &msg](int) {
+      out.clear();
+      for (int idx{}; idx < kBatch; ++idx) wire::encode(out, msg);
+      return kBatch;
+    });
+
+    // out holds the last batch encoded
+    const auto& encoded = out;
+    msg_type var{};
+    harness.run(name + " decode", [&encoded, &var](int) {
+      wire::reader_t in{encoded.bytes()};
+      while (auto frame = wire::next(in)) wire::decode(*frame, var);
+      return kBatch;
+    });
+
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      // units are the frames viewed, so a failed view shows as fewer units
+      harness.run(name + " view", [&encoded](int) {
+        wire::reader_t in{encoded.bytes()};
+        int viewed{};
+        while (auto frame = wire::next(in)) {
+          viewed += (wire::view<T>(*frame) != nullptr);
+        }
+        return viewed;
+      });
+    }
+  }
+
+  // A frame whose vector count is more than its payload could hold is
+  // rejected as truncated, before the vector is sized.
+  void check_corrupt_count(bench::harness_t& harness) {
+    wire::writer_t out;
+    wire::encode(out, make_rows());
+    out.patch(sizeof(wire::header_t), std::uint32_t{0xffff'ffff});
+    wire::reader_t in{out.bytes()};
+    msg_type var{};
+    try {
+      wire::decode(*wire::next(in), var);
+      harness.fail("rows (corrupt count)", "decoded");
+    } catch (const std::runtime_error&) {
+    }
+  }
+}  // namespace wire_bench
+
+int main(int argc, char* argv[]) {
+  using namespace wire_bench;
+#ifndef NDEBUG
+  bench::options_t defaults{.iters{2}};
+#else
+  bench::options_t defaults{.iters{100'000}, .warmup{1'000}, .reps{5}};
+#endif
+  bench::harness_t harness{bench::parse_args(argc, argv, defaults)};
+  run(harness, "point (8B)", msg::point_t{3, 4});
+  run(harness, "quote (128B)", msg::quote_t{{"COPE"}, {1.0, 2.0, 3.0}});
+  run(harness, "note (string)",
+      msg::note_t{"a note long enough to not fit in the small string buffer"});
+  run(harness, "rows (15 rows)", make_rows());
+  check_corrupt_count(harness);
+  return harness.finish();
+}
@@ -0,0 +1,193 @@
+// sellitem_columns.h
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include "cope_intern.h"
+#include "cope_wire.h"
+#include "sellitem_msg.h"
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace sellitem::msg {
+  // sellitem::msg::columns_t
+  //
+  // A row table stored by column, an alternative to data_t for large
+  // tables: each row's name is an index into a per-table list of the
+  // distinct name symbols, prices are contiguous, and the listed and
+  // selected flags are bitsets of 64 rows per word. Candidate rows are
+  // found with SIMD compares over the columns; see for_each_candidate().
+  struct columns_t {
+    static constexpr std::size_t kWordBits{64};
+
+    std::size_t size() const { return prices.size(); }
+
+    // the index of name in names, if any row has it
+    std::optional<std::int32_t> name_id(cope::intern::symbol_t name) const {
+      auto it = std::find(names.begin(), names.end(), name);
+      if (it == names.end()) return std::nullopt;
+      return (std::int32_t)(it - names.begin());
+    }
+
+    void push_back(const row_data_t& row) {
+      auto id = name_id(row.item_name);
+      if (!id) {
+        id = (std::int32_t)names.size();
+        names.push_back(row.item_name);
+      }
+      const auto row_idx = size();
+      name_ids.push_back(*id);
+      prices.push_back(row.item_price);
+      if (!(row_idx % kWordBits)) {
+        listed.push_back(0);
+        selected.push_back(0);
+      }
+      set_listed(row_idx, row.item_listed);
+      set_selected(row_idx, row.selected);
+    }
+
+    bool is_listed(std::size_t row_idx) const { return test(listed, row_idx); }
+    void set_listed(std::size_t row_idx, bool value) {
+      set(listed, row_idx, value);
+    }
+    bool is_selected(std::size_t row_idx) const {
+      return test(selected, row_idx);
+    }
+    void set_selected(std::size_t row_idx, bool value) {
+      set(selected, row_idx, value);
+    }
+
+    // Whether the columns are consistent: name_ids and prices have a row
+    // each, the bitsets a word per 64 rows, and every name id indexes
+    // names. Columns decoded from the wire or a trace must be checked
+    // before they are read.
+    bool valid() const {
+      const auto num_words = (size() + kWordBits - 1) / kWordBits;
+      return (name_ids.size() == size()) && (listed.size() == num_words)
+          && (selected.size() == num_words)
+          && std::all_of(name_ids.begin(), name_ids.end(),
+              [this](std::int32_t id) {
+                return (id >= 0) && ((std::size_t)id < names.size());
+              });
+    }
+
+    row_data_t row(std::size_t row_idx) const {
+      return {names[name_ids[row_idx]], prices[row_idx], is_listed(row_idx),
+          is_selected(row_idx)};
+    }
+
+    std::optional<int> find_selected_row() const {
+      for (std::size_t word{}; word < selected.size(); ++word) {
+        if (auto bits = selected[word]) {
+          return (int)(word * kWordBits + std::countr_zero(bits));
+        }
+      }
+      return std::nullopt;
+    }
+
+    std::vector<cope::intern::symbol_t> names;
+    std::vector<std::int32_t> name_ids;
+    std::vector<std::int32_t> prices;
+    std::vector<std::uint64_t> listed;
+    std::vector<std::uint64_t> selected;
+
+  private:
+    static bool test(const std::vector<std::uint64_t>& bits,
+        std::size_t row_idx) {
+      return (bits[row_idx / kWordBits] >> (row_idx % kWordBits)) & 1;
+    }
+    static void set(std::vector<std::uint64_t>& bits, std::size_t row_idx,
+        bool value) {
+      const auto mask = std::uint64_t{1} << (row_idx % kWordBits);
+      auto& word = bits[row_idx / kWordBits];
+      word = value ? (word | mask) : (word & ~mask);
+    }
+  };  // sellitem::msg::columns_t
+
+  namespace detail {
+    struct match_masks_t {
+      std::uint64_t name_eq;
+      std::uint64_t price_ne;
+    };
+
+    // Compares count (<= 64) rows starting at first against name_id and
+    // price; bit i of each mask is for row first + i.
+    inline match_masks_t match_rows(const columns_t& columns,
+        std::size_t first, std::size_t count, std::int32_t name_id,
+        std::int32_t price) {
+      const auto names = columns.name_ids.data() + first;
+      const auto prices = columns.prices.data() + first;
+      match_masks_t masks{};
+      std::size_t idx{};
+#if defined(__AVX2__)
+      const auto name_v = _mm256_set1_epi32(name_id);
+      const auto price_v = _mm256_set1_epi32(price);
+      for (; idx + 8 <= count; idx += 8) {
+        const auto n = _mm256_loadu_si256((const __m256i*)(names + idx));
+        const auto p = _mm256_loadu_si256((const __m256i*)(prices + idx));
+        const auto name_eq = _mm256_movemask_ps(
+            _mm256_castsi256_ps(_mm256_cmpeq_epi32(n, name_v)));
+        const auto price_eq = _mm256_movemask_ps(
+            _mm256_castsi256_ps(_mm256_cmpeq_epi32(p, price_v)));
+        masks.name_eq |= (std::uint64_t)(unsigned)name_eq << idx;
+        masks.price_ne |= (std::uint64_t)(~price_eq & 0xff) << idx;
+      }
+#elif defined(__SSE2__) || defined(_M_X64)
+      const auto name_v = _mm_set1_epi32(name_id);
+      const auto price_v = _mm_set1_epi32(price);
+      for (; idx + 4 <= count; idx += 4) {
+        const auto n = _mm_loadu_si128((const __m128i*)(names + idx));
+        const auto p = _mm_loadu_si128((const __m128i*)(prices + idx));
+        const auto name_eq =
+            _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(n, name_v)));
+        const auto price_eq =
+            _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(p, price_v)));
+        masks.name_eq |= (std::uint64_t)(unsigned)name_eq << idx;
+        masks.price_ne |= (std::uint64_t)(~price_eq & 0xf) << idx;
+      }
+#endif
+      for (; idx < count; ++idx) {
+        masks.name_eq |= (std::uint64_t)(names[idx] == name_id) << idx;
+        masks.price_ne |= (std::uint64_t)(prices[idx] != price) << idx;
+      }
+      return masks;
+    }
+  }  // namespace detail
+
+  // Calls fn(row_idx), in row order, for each row named name whose price
+  // isn't price or that isn't listed: a sellitem candidate row. columns
+  // must be valid().
+  template <typename FnT>
+  void for_each_candidate(const columns_t& columns,
+      cope::intern::symbol_t name, std::int32_t price, FnT&& fn) {
+    const auto name_id = columns.name_id(name);
+    if (!name_id) return;
+    constexpr auto kWordBits = columns_t::kWordBits;
+    for (std::size_t word{}; word < columns.listed.size(); ++word) {
+      const auto first = word * kWordBits;
+      const auto count = std::min(kWordBits, columns.size() - first);
+      const auto masks =
+          detail::match_rows(columns, first, count, *name_id, price);
+      auto bits = masks.name_eq & (masks.price_ne | ~columns.listed[word]);
+      while (bits) {
+        fn((int)(first + std::countr_zero(bits)));
+        bits &= bits - 1;
+      }
+    }
+  }
+}  // namespace sellitem::msg
+
+template <>
+struct cope::wire::codec_t<sellitem::msg::columns_t>
+    : cope::wire::fields_codec_t<&sellitem::msg::columns_t::names,
+          &sellitem::msg::columns_t::name_ids,
+          &sellitem::msg::columns_t::prices,
+          &sellitem::msg::columns_t::listed,
+          &sellitem::msg::columns_t::selected> {};
@@ -5,11 +5,13 @@
 #include <optional>
 #include <string>
 #include <vector>
+#include "cope_intern.h"
 #include "cope_result.h"
+#include "cope_wire.h"
 
 namespace sellitem::msg {
   struct row_data_t {
-    std::string item_name;
+    cope::intern::symbol_t item_name;
     int item_price;
     bool item_listed;
     bool selected;
@@ -31,6 +33,19 @@ namespace sellitem::msg {
     row_vector rows;
   };  // sellitem::msg::data_t
 
+  // The rows of a table that changed since the previous data_t or
+  // delta_t, by index. The table's size is unchanged; a table that gained
+  // or lost rows is sent whole, as a data_t.
+  struct delta_t {
+    struct row_t {
+      int row_idx;
+      row_data_t row;
+    };
+    using row_vector = std::vector<row_t>;
+
+    row_vector rows;
+  };  // sellitem::msg::delta_t
+
   template <typename Msg>
   inline cope::result_t validate(const Msg& msg) {
     // TODO: use cope::msg::validate<data_t>(msg)
@@ -40,3 +55,23 @@ namespace sellitem::msg {
                : result_code::e_unexpected_msg_type;
   }
 }  // namespace sellitem::msg
+
+template <>
+struct cope::wire::codec_t<sellitem::msg::row_data_t>
+    : cope::wire::fields_codec_t<&sellitem::msg::row_data_t::item_name,
+          &sellitem::msg::row_data_t::item_price,
+          &sellitem::msg::row_data_t::item_listed,
+          &sellitem::msg::row_data_t::selected> {};
+
+template <>
+struct cope::wire::codec_t<sellitem::msg::data_t>
+    : cope::wire::fields_codec_t<&sellitem::msg::data_t::rows> {};
+
+template <>
+struct cope::wire::codec_t<sellitem::msg::delta_t::row_t>
+    : cope::wire::fields_codec_t<&sellitem::msg::delta_t::row_t::row_idx,
+          &sellitem::msg::delta_t::row_t::row> {};
+
+template <>
+struct cope::wire::codec_t<sellitem::msg::delta_t>
+    : cope::wire::fields_codec_t<&sellitem::msg::delta_t::rows> {};
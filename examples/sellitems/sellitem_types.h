@@ -2,9 +2,13 @@
 
 #pragma once
 
+#include <cstddef>
 #include <optional>
 #include <tuple>
+#include <vector>
 #include "cope.h"
+#include "cope_wire.h"
+#include "sellitem_columns.h"
 #include "sellitem_msg.h"
 #include "setprice_msg.h"
 #include "ui_msg.h"
@@ -23,15 +27,39 @@ namespace sellitem {
     struct state_t {
       // TODO can these constructors just be removed? try commenting out
       state_t() = default;
-      state_t(const std::string& item_name, int item_price)
+      state_t(cope::intern::symbol_t item_name, int item_price)
           : item_name(item_name), item_price(item_price) {}
+      state_t(const state_t&) = default;
+      state_t(state_t&&) = default;
+      state_t& operator=(const state_t&) = default;
+      state_t& operator=(state_t&&) = default;
 
-      std::string item_name;
+      cope::intern::symbol_t item_name;
       int item_price;
 
       std::optional<int> row_idx{};
       std::optional<action> next_action{};
       //      std::optional<cope::operation> next_operation{};
+
+      // a candidate row's index, and the columns that decide its next
+      // action
+      struct candidate_t {
+        int row_idx;
+        int item_price;
+        bool item_listed;
+        bool selected;
+      };
+
+      // Candidate rows in row order, kept across frames so that a delta_t
+      // is applied in time proportional to the candidates it changes.
+      // Rebuilt in place by each data_t or columns_t, so once its
+      // capacity has grown to the most candidates a frame has, frames
+      // don't allocate. The manager keeps that capacity between txns. Not
+      // sent on the wire.
+      std::vector<candidate_t> candidates{};
+      // rows in the last data_t or columns_t; a delta_t's row indices
+      // must be below it
+      std::size_t num_rows{};
     };
 
     // task type
@@ -43,9 +71,44 @@ namespace sellitem {
     using start_txn_t = cope::msg::start_txn_t<data_t, txn::state_t>;
 
     struct types {
-      using in_tuple_t = std::tuple<start_txn_t, data_t, setprice::msg::data_t>;
+      // a data_t frame may be sent by reference, through a raw_ptr_t
+      using in_tuple_t = std::tuple<start_txn_t, data_t,
+          cope::proxy::raw_ptr_t<data_t>, delta_t, columns_t,
+          setprice::msg::data_t>;
       using out_tuple_t = std::tuple<ui::msg::click_widget::data_t,
           ui::msg::click_table_row::data_t>;
     }; // types
   } // namespace msg
 } // namespace sellitem
+
+template <>
+struct cope::msg::info_t<sellitem::msg::start_txn_t> {
+  static constexpr std::string_view name{"sellitem::start_txn"};
+};
+
+template <>
+struct cope::msg::info_t<sellitem::msg::data_t> {
+  static constexpr std::string_view name{"sellitem::msg"};
+};
+
+template <>
+struct cope::msg::info_t<cope::proxy::raw_ptr_t<sellitem::msg::data_t>> {
+  static constexpr std::string_view name{"sellitem::msg (raw_ptr)"};
+};
+
+template <>
+struct cope::msg::info_t<sellitem::msg::delta_t> {
+  static constexpr std::string_view name{"sellitem::delta"};
+};
+
+template <>
+struct cope::msg::info_t<sellitem::msg::columns_t> {
+  static constexpr std::string_view name{"sellitem::columns"};
+};
+
+template <>
+struct cope::wire::codec_t<sellitem::txn::state_t>
+    : cope::wire::fields_codec_t<&sellitem::txn::state_t::item_name,
+          &sellitem::txn::state_t::item_price,
+          &sellitem::txn::state_t::row_idx,
+          &sellitem::txn::state_t::next_action> {};
@@ -1,13 +1,21 @@
 ﻿// sellitems.cpp
 
 #include "msvc_wall.h"
+#include <algorithm>
+#include <array>
 #include <cassert>
-#include <chrono>
+#include <cstdint>
+#include <exception>
 #include <format>
 #include <iostream>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <variant>
+#include <vector>
 #include "cope.h"
+#include "cope_trace.h"
+#include "harness.h"
 #include "txsellitem.h"
 #include "ui_msg.h"
 #include "internal/cope_log.h"
@@ -17,27 +25,72 @@ using namespace std::literals;
 namespace {
   namespace log = cope::log;
 
+  const auto kMagicBalls{cope::intern::intern("magic balls")};
+  const auto kMagicBeans{cope::intern::intern("magic beans")};
+
   namespace state {
     using namespace sellitem::msg;
 
     const data_t::row_vector const_rows_page_1{
-      { "magic balls", 7, false, false }, // 0
-      { "magic beans", 1, false, false },
-      { "magic beans", 1, false, false },
-      { "magic beans", 1, true, false },
-      { "magic beans", 1, false, true },
-      { "magic beans", 1, true, true },   // 5
-      { "magic balls", 7, false, false },
-      { "magic beans", 2, false, false },
-      { "magic beans", 2, true, false },
-      { "magic beans", 2, false, true },
-      { "magic beans", 2, true, true },   // 10
-      { "magic balls", 8, false, false },
-      { "magic beans", 3, false, true },
-      { "magic beans", 5, true, false },
-      { "magic balls", 9, false, false }  // 14
+      { kMagicBalls, 7, false, false }, // 0
+      { kMagicBeans, 1, false, false },
+      { kMagicBeans, 1, false, false },
+      { kMagicBeans, 1, true, false },
+      { kMagicBeans, 1, false, true },
+      { kMagicBeans, 1, true, true },   // 5
+      { kMagicBalls, 7, false, false },
+      { kMagicBeans, 2, false, false },
+      { kMagicBeans, 2, true, false },
+      { kMagicBeans, 2, false, true },
+      { kMagicBeans, 2, true, true },   // 10
+      { kMagicBalls, 8, false, false },
+      { kMagicBeans, 3, false, true },
+      { kMagicBeans, 5, true, false },
+      { kMagicBalls, 9, false, false }  // 14
     };
-    data_t::row_vector rows_page_1;
+    // Double-buffered frame snapshots, which are also the driver's model of
+    // the rows. Changes are made to the back buffer through edit(), which
+    // notes the row. publish() makes the back buffer the front, which the
+    // txn reads by reference, and then brings the new back buffer (the old
+    // front) up to date by copying only the noted rows. By then the
+    // send_msg() that delivered the old front has returned, and the txn has
+    // moved past it. A frame so costs O(changes), not O(rows), and doesn't
+    // allocate.
+    class frames_t {
+    public:
+      void reset(const data_t::row_vector& rows) {
+        for (auto& buffer : buffers_) {
+          buffer.rows.assign(rows.begin(), rows.end());
+        }
+        changed_.clear();
+      }
+
+      const data_t::row_vector& rows() const {
+        return buffers_[front_ ^ 1].rows;
+      }
+
+      row_data_t& edit(std::size_t row_idx) {
+        if (changed_.empty() || (changed_.back() != row_idx)) {
+          changed_.push_back(row_idx);
+        }
+        return buffers_[front_ ^ 1].rows[row_idx];
+      }
+
+      data_t& publish() {
+        front_ ^= 1;
+        const auto& front = buffers_[front_].rows;
+        auto& back = buffers_[front_ ^ 1].rows;
+        for (auto row_idx : changed_) back[row_idx] = front[row_idx];
+        changed_.clear();
+        return buffers_[front_];
+      }
+
+    private:
+      std::array<data_t, 2> buffers_;
+      std::size_t front_{};
+      std::vector<std::size_t> changed_;
+    };
+    frames_t frames;
 
     bool first{ true };
     bool in_setprice{};
@@ -53,7 +106,7 @@ namespace {
       listed_clicked = false;
       final_message_sent = false;
       row_index = 0u;
-      rows_page_1 = const_rows_page_1;
+      frames.reset(const_rows_page_1);
     }
   }
 
@@ -65,15 +118,16 @@ namespace {
 
     out_msg = -1; //cope::msg::id::kUndefined;
     out_extra.clear();
-    for (; row_index < rows_page_1.size(); ++row_index,
+    const auto& rows = frames.rows();
+    for (; row_index < rows.size(); ++row_index,
       first = true,
       setprice_clicked = false,
       in_setprice = false,
       listed_clicked = false)
     {
-      auto& row = rows_page_1[row_index];
+      const auto& row = rows[row_index];
 
-      if (row.item_name != "magic beans") continue;
+      if (row.item_name != kMagicBeans) continue;
       if (row.item_price == 2 && row.item_listed) continue;
 
       if (first) {
@@ -87,7 +141,7 @@ namespace {
           if (xtralog) log::info("****1 ");
           break;
         }
-        row.selected = true;
+        frames.edit(row_index).selected = true;
       }
 
       if (row.item_price != 2 && !setprice_clicked) {
@@ -107,7 +161,7 @@ namespace {
         out_msg = ui::msg::id::kClickWidget; // click ok_button
         if (xtralog) log::info("****4  price({}) row({})", row.item_price,
           row_index);
-        row.item_price = 2;
+        frames.edit(row_index).item_price = 2;
         break;
       }
 
@@ -119,21 +173,20 @@ namespace {
           if (xtralog) log::info("****5 ");
           break;
         }
-        row.item_listed = true;
+        frames.edit(row_index).item_listed = true;
       }
     }
     first = false;
 
-    std::variant<std::monostate, data_t::row_vector, int> result{};
+    // a published frame, or a price for the setprice txn
+    std::variant<std::monostate, data_t*, int> result{};
     if (in_setprice) {
-      result = rows_page_1[row_index].item_price;
+      result = rows[row_index].item_price;
     } else {
-      if (row_index < rows_page_1.size() || !final_message_sent) {
-        // unnecessary. pass & copy directly below w/no move
-        data_t::row_vector rows_copy = rows_page_1;
-        result = rows_copy;
+      if (row_index < rows.size() || !final_message_sent) {
+        result = &frames.publish();
       }
-      if (row_index == rows_page_1.size()) {
+      if (row_index == rows.size()) {
         final_message_sent = !final_message_sent;
       }
     }
@@ -143,91 +196,223 @@ namespace {
   constexpr inline auto dispatch = [](const auto& msg) {
     using namespace cope;
     //using namespace ui::msg;
-    auto msg_name = ui::msg::get_type_name(msg);
-    if (!msg_name.has_value()) {
+    using T = std::decay_t<decltype(msg)>;
+    if constexpr (!ui::msg::is_ui_msg<T>) {
       log::info("dispatch: unsupported message");
       return result_code::e_unexpected_msg_type;
+    } else {
+      log::info("dispatching {}...", cope::msg::name_of<T>);
+      return result_code::s_ok;
     }
-    log::info("dispatching {}...", msg_name.value());
-    return result_code::s_ok;
   };
 
-  auto run(sellitem::txn::task_type& task) {
-    assert(task.promise().txn_ready());
-    state::reset();
-    int frame_count{};
-    while (true) {
-      int expected_out_msg_id;
-      std::string extra;
-      auto var = get_data(expected_out_msg_id, extra);
-      // TODO get_data can do this
-      std::variant<sellitem::msg::data_t, setprice::msg::data_t,
-          sellitem::msg::start_txn_t> v2;
-      using namespace sellitem;
-      if (std::holds_alternative<msg::data_t::row_vector>(var)) {
-        auto& rows = std::get<msg::data_t::row_vector>(var);
-        auto msg = msg::data_t{ std::move(rows) };
-        if (!task.promise().txn_running()) {
-          // todo: 2-param constructor?  check c++ is trivial cppnow jason turner 2024
-          auto state = txn::state_t{"magic beans"s, 2};
-          v2 = msg::start_txn_t{ std::move(msg), std::move(state) };
-        } else {
-          v2 = msg;
-        }
+  constexpr inline auto send_direct = [](auto& task, auto&& msg)
+      -> decltype(auto) {
+    return task.send_msg(std::forward<decltype(msg)>(msg));
+  };
+
+  // Send one frame of data to task, through send(task, msg). Returns false
+  // once the frame that completes the sellitem txn has been sent.
+  template <typename SendFnT = decltype(send_direct)>
+  bool send_frame(sellitem::txn::task_type& task,
+      const SendFnT& send = send_direct) {
+    int expected_out_msg_id;
+    std::string extra;
+    auto var = get_data(expected_out_msg_id, extra);
+    // TODO get_data can do this
+    std::variant<cope::proxy::raw_ptr_t<sellitem::msg::data_t>,
+        setprice::msg::data_t, sellitem::msg::start_txn_t> v2;
+    using namespace sellitem;
+    if (std::holds_alternative<msg::data_t*>(var)) {
+      auto& frame = *std::get<msg::data_t*>(var);
+      if (!task.promise().txn_running()) {
+        // todo: 2-param constructor?  check c++ is trivial cppnow jason turner 2024
+        auto state = txn::state_t{kMagicBeans, 2};
+        // a start_txn_t carries its frame by value, so a txn's first
+        // frame is a copy
+        v2 = msg::start_txn_t{ frame, std::move(state) };
       } else {
-        assert(std::holds_alternative<int>(var));
-        v2 = setprice::msg::data_t{ std::get<int>(var) };
-      }
-      //log::info("constructed {}", app::get_type_name(v2));
-      int out_msg_id{};
-      std::visit([&task, &out_msg_id](auto&& msg) {
-        [[maybe_unused]] const auto& var = task.send_msg(std::move(msg));
-        if (task.promise().txn_running()) {
-          std::visit(dispatch, var);
+        v2 = cope::proxy::raw_ptr_t<msg::data_t>{ frame };
+      }
+    } else {
+      assert(std::holds_alternative<int>(var));
+      v2 = setprice::msg::data_t{ std::get<int>(var) };
+    }
+    //log::info("constructed {}", cope::msg::name(v2));
+    int out_msg_id{};
+    std::visit([&task, &send, &out_msg_id](auto&& msg) {
+      [[maybe_unused]] const auto& var = send(task, std::move(msg));
+      if (task.promise().txn_running()) {
+        std::visit(dispatch, var);
+      }
+      out_msg_id = ::ui::msg::get_id(var);
+    }, v2);
+    //assert(out_msg_id == expected_out_msg_id);
+    if (!task.promise().txn_running()) {
+      assert(expected_out_msg_id == -1);
+      return false;
+    }
+    return true;
+  }
+
+  // Removes "--record <path>" or "--replay <path>" from argv, leaving the
+  // rest for bench::parse_args.
+  std::optional<std::string> take_arg(int& argc, char* argv[],
+      std::string_view name) {
+    for (int i{1}; i + 1 < argc; ++i) {
+      if (argv[i] != name) continue;
+      std::string value{argv[i + 1]};
+      std::copy(argv + i + 2, argv + argc, argv + i);
+      argc -= 2;
+      return value;
+    }
+    return std::nullopt;
+  }
+
+  // Send iters frames, and then the rest of the txn in progress, recording
+  // them to path. Returns a process exit code.
+  int record(sellitem::txn::task_type& task, const std::string& path,
+      int iters) {
+    try {
+      cope::trace::recorder_t<app::context_t> recorder{path};
+      auto send = [&recorder](auto& task, auto&& msg) -> decltype(auto) {
+        return recorder.send_msg(task, std::forward<decltype(msg)>(msg));
+      };
+      for (int frame{1};; ++frame) {
+        if (!send_frame(task, send)) {
+          if (frame >= iters) break;
+          state::reset();
         }
-        out_msg_id = ::ui::msg::get_id(var);
-      }, v2);
-      //assert(out_msg_id == expected_out_msg_id);
-      ++frame_count;
-      if (!task.promise().txn_running()) {
-        assert(expected_out_msg_id == -1);
-        break;
       }
+      recorder.close();
+      std::cerr << "recorded " << recorder.num_records() << " messages to "
+                << path << std::endl;
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
     }
-    return frame_count;
+    return 0;
+  }
+
+  // A table of num_rows rows whose only candidate is the last. Each frame
+  // toggles the candidate's selected flag, which the txn answers with a
+  // click, and is sent as the whole table, by row or by column, or as a
+  // one-row delta. Then a delta for a row that doesn't exist, and columns
+  // whose sizes don't match, each of which must fail the txn.
+  void run_rows(bench::harness_t& harness, int num_rows) {
+    using namespace sellitem;
+    app::context_t context{};
+    auto task{cope::txn::basic_handler<txn::task_t, txn::manager_t>(
+        context, kTxnId)};
+    msg::data_t::row_vector rows((std::size_t)num_rows - 1,
+        {kMagicBalls, 7, false, false});
+    rows.push_back({kMagicBeans, 1, false, false});
+    [[maybe_unused]] const auto& out = task.send_msg(msg::start_txn_t{
+        msg::data_t{msg::data_t::row_vector{rows}},
+        txn::state_t{kMagicBeans, 2}});
+
+    const auto iters = harness.options().iters;
+    const auto suffix = " (" + std::to_string(num_rows) + " rows)";
+    // the sent messages are moved back out of context.in() for reuse
+    harness.run("sellitems full" + suffix,
+        std::max(10, iters / num_rows),
+        [&task, &context, &rows](int) {
+          rows.back().selected = !rows.back().selected;
+          [[maybe_unused]] const auto& out =
+              task.send_msg(msg::data_t{std::move(rows)});
+          rows = std::move(std::get<msg::data_t>(context.in()).rows);
+        });
+    msg::columns_t columns;
+    for (const auto& row : rows) columns.push_back(row);
+    harness.run("sellitems columns" + suffix,
+        std::max(10, iters / num_rows),
+        [&task, &context, &columns, num_rows](int) {
+          const auto row_idx = (std::size_t)num_rows - 1;
+          columns.set_selected(row_idx, !columns.is_selected(row_idx));
+          [[maybe_unused]] const auto& out = task.send_msg(std::move(columns));
+          columns = std::move(std::get<msg::columns_t>(context.in()));
+        });
+    msg::delta_t delta{{{num_rows - 1, rows.back()}}};
+    harness.run("sellitems delta" + suffix,
+        std::max(1, iters / 10),
+        [&task, &context, &delta](int) {
+          auto& row = delta.rows.front().row;
+          row.selected = !row.selected;
+          [[maybe_unused]] const auto& out = task.send_msg(std::move(delta));
+          delta = std::move(std::get<msg::delta_t>(context.in()));
+        });
+    if (!task.promise().txn_running()) {
+      harness.fail("sellitems" + suffix, "txn completed");
+    }
+    // send msg to a running txn; it must fail the txn
+    auto check_rejected = [&](auto&& bad_msg, const char* what) {
+      if (!task.promise().txn_running()) {
+        [[maybe_unused]] const auto& out = task.send_msg(msg::start_txn_t{
+            msg::data_t{msg::data_t::row_vector{rows}},
+            txn::state_t{kMagicBeans, 2}});
+      }
+      [[maybe_unused]] const auto& out = task.send_msg(std::move(bad_msg));
+      if (task.promise().txn_running()
+          || (context.result().code != cope::result_code::e_fail)) {
+        harness.fail("sellitems" + suffix, what);
+      }
+    };
+    check_rejected(msg::delta_t{{{num_rows, rows.back()}}},
+        "bad delta row_idx accepted");
+    // a bitset word more than the rows need
+    auto bad_columns = columns;
+    bad_columns.listed.push_back(0);
+    check_rejected(std::move(bad_columns), "bad columns sizes accepted");
+    bad_columns = columns;
+    bad_columns.name_ids.back() = (std::int32_t)bad_columns.names.size();
+    check_rejected(std::move(bad_columns), "bad columns name id accepted");
   }
 } // namespace (anon)
 
-int main() {
-  using namespace std::chrono;
+int main(int argc, char* argv[]) {
 #ifndef NDEBUG
   cope::log::enable();
-  int num_iter{ 1 };
+  // one sellitem txn
+  bench::options_t defaults{.iters{33}};
 #else
-  int num_iter{ 100000 };
+  bench::options_t defaults{.iters{3'300'000}, .warmup{33'000}, .reps{5}};
 #endif
-  app::get_type_name_t get_type_name{};
-  app::context_t context{ get_type_name };
+  auto record_path = take_arg(argc, argv, "--record");
+  auto replay_path = take_arg(argc, argv, "--replay");
+  bench::harness_t harness{bench::parse_args(argc, argv, defaults)};
+
+  app::context_t context{};
   auto sellitem_task{
       cope::txn::basic_handler<sellitem::txn::task_t, sellitem::txn::manager_t>(
           context, sellitem::kTxnId)};
 
-  int total_frames{};
-  auto start = high_resolution_clock::now();
-  for (int iter{}; iter < num_iter; ++iter) {
-    auto num_frames = run(sellitem_task);
-    total_frames += num_frames;
+  assert(sellitem_task.promise().txn_ready());
+  state::reset();
+  if (record_path.has_value()) {
+    return record(sellitem_task, *record_path, harness.options().iters);
   }
-  auto end = high_resolution_clock::now();
-  [[maybe_unused]] auto elapsed =
-      (double)duration_cast<nanoseconds>(end - start).count();
-  std::cerr << num_iter << " iters, " << total_frames << " frames"
-#ifdef NDEBUG
-            << std::fixed << std::setprecision(2)
-            << ", Elapsed: " << elapsed * 1e-6 << "ms "
-            << std::setprecision(0)
-            << "(" << elapsed / total_frames << "ns/frame)"
-#endif
-            << std::endl;
-  return 0;
+  if (replay_path.has_value()) {
+    cope::trace::replayer_t<app::context_t> replayer{*replay_path};
+    auto stats = replayer.replay(sellitem_task);
+    std::cerr << "replay: " << stats.in_msgs << " in, " << stats.out_msgs
+              << " out, " << stats.out_mismatches << " mismatched"
+              << std::endl;
+    const auto iters = std::max(1, harness.options().iters
+        / (int)std::max<std::size_t>(1, stats.in_msgs));
+    harness.run("sellitems (replay)", iters,
+        [&replayer, &sellitem_task](int) {
+          return (int)replayer.replay(sellitem_task).in_msgs;
+        });
+    return harness.finish();
+  }
+  harness.run("sellitems (frame)", harness.options().iters,
+      [&sellitem_task](int) {
+        if (!send_frame(sellitem_task)) {
+          state::reset();
+        }
+      });
+  for (int num_rows : {10, 1'000, 100'000}) {
+    run_rows(harness, num_rows);
+  }
+  return harness.finish();
 }
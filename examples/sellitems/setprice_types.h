@@ -4,6 +4,7 @@
 
 #include <optional>
 #include "cope.h"
+#include "sellitem_columns.h"
 #include "sellitem_msg.h"
 #include "setprice_msg.h"
 #include "ui_msg.h"
@@ -35,10 +36,22 @@ namespace setprice {
 
     struct types {
       using in_tuple_t =
-          std::tuple<start_txn_t, msg::data_t, sellitem::msg::data_t>;
+          std::tuple<start_txn_t, msg::data_t, sellitem::msg::data_t,
+              cope::proxy::raw_ptr_t<sellitem::msg::data_t>,
+              sellitem::msg::delta_t, sellitem::msg::columns_t>;
       using out_tuple_t = std::tuple<ui::msg::click_widget::data_t,
           ui::msg::send_chars::data_t>;
     };  // types
   }  // namespace msg
 } // namespace setprice
 
+template <>
+struct cope::msg::info_t<setprice::msg::start_txn_t> {
+  static constexpr std::string_view name{"setprice::start_txn"};
+};
+
+template <>
+struct cope::msg::info_t<setprice::msg::data_t> {
+  static constexpr std::string_view name{"setprice::msg"};
+};
+
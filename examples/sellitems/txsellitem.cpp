@@ -1,6 +1,8 @@
 // txsellitem.cpp
 
 #include "msvc_wall.h"
+#include <algorithm>
+#include <cstddef>
 #include "txsellitem.h"
 #include "internal/cope_log.h"
 
@@ -57,32 +59,109 @@ namespace {
            && ((row.item_price != state.item_price) || !row.item_listed);
   }
 
-  auto get_next_action(const msg::row_data_t& row, const txn::state_t& state) {
+  // row is a msg::row_data_t or a txn::state_t::candidate_t
+  std::optional<action> get_next_action(const auto& row,
+      const txn::state_t& state) {
     // if (row.item_name != state.item_name) return
     // row_state::item_name_mismatch;
     if (!row.selected) return action::select_row;
     if (row.item_price != state.item_price) return action::set_price;
     if (!row.item_listed) return action::list_item;
-    throw new std::runtime_error("sellitem::txn::get_next_action()");
+    log::error("sellitem::txn::get_next_action(): no action for row");
+    return std::nullopt;
+  }
+
+  auto as_candidate(int row_idx, const msg::row_data_t& row) {
+    return txn::state_t::candidate_t{row_idx, row.item_price,
+        row.item_listed, row.selected};
+  }
+
+  void update_candidate(int row_idx, const msg::row_data_t& row,
+      txn::state_t& state) {
+    auto& candidates = state.candidates;
+    auto it = std::lower_bound(candidates.begin(), candidates.end(), row_idx,
+        [](const auto& candidate, int idx) { return candidate.row_idx < idx; });
+    const bool indexed = (it != candidates.end()) && (it->row_idx == row_idx);
+    if (is_candidate_row(row, state)) {
+      if (indexed) {
+        *it = as_candidate(row_idx, row);
+      } else {
+        candidates.insert(it, as_candidate(row_idx, row));
+      }
+    } else if (indexed) {
+      candidates.erase(it);
+    }
+  }
+
+  // act on the first candidate row, if any
+  cope::expected_operation next_operation(txn::state_t& state) {
+    if (state.candidates.empty()) {
+      log::info("row: none");
+      return cope::operation::complete;
+    }
+    const auto& row = state.candidates.front();
+    log::info(" row: {}, actual price: {}, expected: {}:{}", row.row_idx,
+        row.item_price, state.item_name, state.item_price);
+    state.row_idx = row.row_idx;
+    // TODO: it's not clear this next_action business is necessary.
+    // couldn't we just store the out_msg in the state?
+    state.next_action = get_next_action(row, state);
+    if (!state.next_action) return std::unexpected(cope::result_code::e_fail);
+    return cope::operation::yield;
   }
 }  // namespace
 
 namespace sellitem::txn {
-  cope::operation update_state(
+  // A full table rebuilds the candidates in row order, in place, keeping
+  // their capacity.
+  cope::expected_operation update_state(
       const msg::data_t& msg, state_t& state) {
+    state.candidates.clear();
+    state.num_rows = msg.rows.size();
     for (size_t row_idx{}; row_idx < msg.rows.size(); ++row_idx) {
-      const auto& row = msg.rows.at(row_idx);
+      const auto& row = msg.rows[row_idx];
       if (is_candidate_row(row, state)) {
-        log::info(" row: {}, actual: {}:{}, expected: {}:{}", row_idx,
-            row.item_name, row.item_price, state.item_name, state.item_price);
-        state.row_idx = row_idx;
-        // TODO: it's not clear this next_action business is necessary.
-        // couldn't we just store the out_msg in the state?
-        state.next_action = get_next_action(row, state);
-        return cope::operation::yield;
+        state.candidates.push_back(as_candidate((int)row_idx, row));
       }
     }
-    log::info("row: none");
-    return cope::operation::complete;
+    return next_operation(state);
+  }
+
+  // As for data_t, with the candidates found by msg::for_each_candidate.
+  // Inconsistent columns fail the txn, and change no candidate.
+  cope::expected_operation update_state(
+      const msg::columns_t& msg, state_t& state) {
+    if (!msg.valid()) {
+      log::error("sellitem::txn::update_state(): inconsistent columns, {} "
+                 "rows", msg.size());
+      return std::unexpected(cope::result_code::e_fail);
+    }
+    auto& candidates = state.candidates;
+    candidates.clear();
+    state.num_rows = msg.size();
+    msg::for_each_candidate(msg, state.item_name, state.item_price,
+        [&msg, &candidates](int row_idx) {
+          candidates.push_back({row_idx, msg.prices[row_idx],
+              msg.is_listed(row_idx), msg.is_selected(row_idx)});
+        });
+    return next_operation(state);
+  }
+
+  // A delta with a row index outside the last full table fails the txn,
+  // and changes no candidate.
+  cope::expected_operation update_state(
+      const msg::delta_t& msg, state_t& state) {
+    for (const auto& delta_row : msg.rows) {
+      if ((delta_row.row_idx < 0)
+          || ((std::size_t)delta_row.row_idx >= state.num_rows)) {
+        log::error("sellitem::txn::update_state(): delta row_idx {} is out "
+                   "of range, {} rows", delta_row.row_idx, state.num_rows);
+        return std::unexpected(cope::result_code::e_fail);
+      }
+    }
+    for (const auto& [row_idx, row] : msg.rows) {
+      update_candidate(row_idx, row, state);
+    }
+    return next_operation(state);
   }
 } // namespace sellitem::txn
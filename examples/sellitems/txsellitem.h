@@ -16,7 +16,12 @@ namespace cope::txn {
 namespace sellitem::txn {
   using task_type = task_t<app::context_t>;
 
-  cope::operation update_state(const msg::data_t& msg, state_t& state);
+  cope::expected_operation update_state(
+      const msg::data_t& msg, state_t& state);
+  cope::expected_operation update_state(
+      const msg::delta_t& msg, state_t& state);
+  cope::expected_operation update_state(
+      const msg::columns_t& msg, state_t& state);
 
   template <cope::txn::Context ContextT>
   struct manager_t : cope::txn::basic_manager_t<state_t, ContextT> {
@@ -31,15 +36,19 @@ namespace sellitem::txn {
             setprice::txn::manager_t, context_type>(
             context, setprice::kTxnId)) {}
 
+    // A txn's state starts with the candidate capacity that the last txn
+    // left behind, so that a new txn's frames don't allocate.
     cope::expected_operation update_state(
         const context_type& context, state_t& state) {
-      // sellitem::msg -> yield next_action_msg
-      if (std::holds_alternative<msg::data_t>(context.in())) {
-        using sellitem::txn::update_state;
-        return update_state(std::get<msg::data_t>(context.in()), state);
+      if (!state.candidates.capacity()) {
+        state.candidates.swap(spare_candidates_);
+        state.candidates.clear();
       }
-      // setprice::msg -> await setprice::start_txn
-      return cope::operation::await;
+      auto result = update_state_for(context, state);
+      if (!result || (*result == cope::operation::complete)) {
+        spare_candidates_.swap(state.candidates);
+      }
+      return result;
     }
 
     yield_msg_type get_yield_msg(const state_t& state) {
@@ -48,7 +57,8 @@ namespace sellitem::txn {
       case action::select_row: return click_table_row(state.row_idx.value());
       case action::set_price: return click_setprice_button();
       case action::list_item: return click_listitem_button();
-      default: throw new std::runtime_error("invalid action");
+      // update_state() yields only with a next action
+      default: return std::monostate{};
       }
     }
 
@@ -59,7 +69,27 @@ namespace sellitem::txn {
     }
 
   private:
+    cope::expected_operation update_state_for(
+        const context_type& context, state_t& state) {
+      // sellitem::msg -> yield next_action_msg
+      using sellitem::txn::update_state;
+      // by value or by reference
+      if (auto data = cope::msg::get_if<msg::data_t>(context.in())) {
+        return update_state(*data, state);
+      }
+      if (std::holds_alternative<msg::delta_t>(context.in())) {
+        return update_state(std::get<msg::delta_t>(context.in()), state);
+      }
+      if (std::holds_alternative<msg::columns_t>(context.in())) {
+        return update_state(std::get<msg::columns_t>(context.in()), state);
+      }
+      // setprice::msg -> await setprice::start_txn
+      return cope::operation::await;
+    }
+
     setprice::txn::task_t<context_type> setprice_task_;
+    // candidate capacity kept between txns
+    std::vector<state_t::candidate_t> spare_candidates_;
   };  // struct manager_t
 
   template <>
@@ -43,7 +43,9 @@ namespace setprice::txn {
       if (std::holds_alternative<msg::data_t>(msg)) {
         // setprice:msg -> yield next_action_msg
         return setprice::txn::update_state(std::get<msg::data_t>(msg), state);
-      } else if (std::holds_alternative<sellitem::msg::data_t>(msg)) {
+      } else if (cope::msg::holds<sellitem::msg::data_t>(msg)
+                 || std::holds_alternative<sellitem::msg::delta_t>(msg)
+                 || std::holds_alternative<sellitem::msg::columns_t>(msg)) {
         // sellitem::msg -> txn::complete
         return cope::operation::complete;
       }
@@ -55,7 +57,8 @@ namespace setprice::txn {
       switch (state.next_action.value()) {
       case action::enter_price: return enter_price_text(state.price);
       case action::click_ok: return click_ok_button();
-      default: throw new std::runtime_error("invalid action");
+      // update_state() yields only with a next action
+      default: return std::monostate{};
       }
     }
   };  // struct manager_t
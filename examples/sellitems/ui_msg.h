@@ -5,8 +5,8 @@
 #ifndef INCLUDE_UI_MSG_H
 #define INCLUDE_UI_MSG_H
 
-#include <format>
-#include <optional>
+#include <string_view>
+#include "cope_msg_registry.h"
 
 namespace ui::msg {
   namespace click_widget {
@@ -43,53 +43,38 @@ namespace ui::msg {
   }
 
   template<typename Variant>
-#if 1
   inline auto get_id(const Variant& var) {
-    auto id = [&var](auto&& arg) -> int {
-      using T = std::decay_t<decltype(arg)>;
-      if constexpr (std::is_same_v<T, click_widget::data_t>) {
-        return id::kClickWidget;
-      } else if constexpr (std::is_same_v<T, click_point::data_t>) {
-        return id::kClickPoint;
-      } else if constexpr (std::is_same_v<T, click_table_row::data_t>) {
-        return id::kClickTableRow;
-      } else if constexpr (std::is_same_v<T, send_chars::data_t>) {
-        return id::kSendChars;
-      } else {
-        return -1;
-      }
-    };
-    return std::visit(id, var);
-#else
-  inline auto get_id(const Variant&) {
-    return -1;
-#endif
+    auto id = cope::msg::id(var);
+    return (id >= id::kFirst) && (id <= id::kLast) ? id : -1;
   }
 
-  template<typename T>
-  inline constexpr auto get_type_name(const T&) -> std::optional<std::string> {
-    return std::nullopt;
-  }
+  template <typename T>
+  inline constexpr bool is_ui_msg =
+      (cope::msg::id_of<T> >= id::kFirst) && (cope::msg::id_of<T> <= id::kLast);
+} // namespace ui::msg
 
-  template<> inline constexpr auto get_type_name(const click_widget::data_t&)
-      -> std::optional<std::string> {
-    return "ui::msg::click_widget";
-  }
+template <>
+struct cope::msg::info_t<ui::msg::click_widget::data_t> {
+  static constexpr std::string_view name{"ui::msg::click_widget"};
+  static constexpr cope::msg::id_type id{ui::msg::id::kClickWidget};
+};
 
-  template<> inline constexpr auto get_type_name(const click_point::data_t&)
-      -> std::optional<std::string> {
-    return "ui::msg::click_point";
-  }
+template <>
+struct cope::msg::info_t<ui::msg::click_point::data_t> {
+  static constexpr std::string_view name{"ui::msg::click_point"};
+  static constexpr cope::msg::id_type id{ui::msg::id::kClickPoint};
+};
 
-  template<> inline constexpr auto get_type_name(const click_table_row::data_t&)
-      -> std::optional<std::string> {
-    return "ui::msg::click_table_row";
-  }
+template <>
+struct cope::msg::info_t<ui::msg::click_table_row::data_t> {
+  static constexpr std::string_view name{"ui::msg::click_table_row"};
+  static constexpr cope::msg::id_type id{ui::msg::id::kClickTableRow};
+};
 
-  template<> inline constexpr auto get_type_name(const send_chars::data_t&)
-      -> std::optional<std::string> {
-    return "ui::msg::send_chars";
-  }
-} // namespace ui::msg
+template <>
+struct cope::msg::info_t<ui::msg::send_chars::data_t> {
+  static constexpr std::string_view name{"ui::msg::send_chars"};
+  static constexpr cope::msg::id_type id{ui::msg::id::kSendChars};
+};
 
 #endif // INCLUDE_UI_MSG_H
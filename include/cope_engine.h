@@ -0,0 +1,224 @@
+// cope_engine.h
+
+#pragma once
+
+#ifndef INCLUDE_COPE_ENGINE_H
+#define INCLUDE_COPE_ENGINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "cope_memory.h"
+#include "cope_txn.h"
+#include "internal/cope_log.h"
+
+namespace cope::engine {
+  // engine::session_t
+  //
+  // A context and its root task, constructed together so the promise's
+  // context reference stays valid for the lifetime of the task. Each
+  // session owns a frame arena, so that with COPE_FRAME_ARENA set the
+  // coroutine frames of its transaction tree are allocated next to each
+  // other. Sessions are owned by an engine_t and never move once
+  // constructed.
+  template <txn::Context ContextT, typename TaskT>
+  struct session_t {
+  public:
+    using context_type = ContextT;
+    using task_type = TaskT;
+
+    session_t() = delete;
+    session_t(const session_t&) = delete;
+    session_t& operator=(const session_t&) = delete;
+
+    // make_task is invoked with the session's context and must return
+    // the root task by value, e.g. a lambda wrapping txn::basic_handler.
+    template <typename MakeTaskFn, typename... Args>
+    explicit session_t(MakeTaskFn&& make_task, Args&&... context_args)
+        : context_(std::forward<Args>(context_args)...),
+          task_(make_task(with_arena(context_, frame_arena_))) {}
+
+    const auto& context() const { return context_; }
+    auto& context() { return context_; }
+
+    const auto& task() const { return task_; }
+    auto& task() { return task_; }
+
+    const auto& frame_arena() const { return frame_arena_; }
+
+  private:
+    static auto& with_arena(context_type& context,
+        memory::frame_arena_t& arena) {
+      context.set_frame_arena(&arena);
+      return context;
+    }
+
+    memory::frame_arena_t frame_arena_;
+    context_type context_;
+    task_type task_;
+  };  // engine::session_t
+
+  struct run_stats_t {
+    std::uint64_t steps{};
+    std::uint64_t steals{};
+  };
+
+  inline unsigned default_num_workers() {
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  // engine::engine_t
+  //
+  // Owns a set of sessions and drives them from a pool of worker threads.
+  // Sessions are sharded round-robin across per-worker run queues; a
+  // worker whose queue runs dry steals queued sessions from its peers.
+  // A session is only ever stepped by one worker at a time, so a context
+  // and its transaction tree never need any synchronization of their own.
+  template <typename SessionT>
+  class engine_t {
+  public:
+    using session_type = SessionT;
+
+    explicit engine_t(unsigned num_workers = default_num_workers())
+        : num_workers_(std::max(1u, num_workers)) {}
+
+    engine_t(const engine_t&) = delete;
+    engine_t& operator=(const engine_t&) = delete;
+
+    template <typename... Args>
+    session_type& emplace_session(Args&&... args) {
+      sessions_.emplace_back(
+          std::make_unique<session_type>(std::forward<Args>(args)...));
+      return *sessions_.back();
+    }
+
+    auto num_workers() const { return num_workers_; }
+    void set_num_workers(unsigned num_workers) {
+      num_workers_ = std::max(1u, num_workers);
+    }
+
+    auto num_sessions() const { return sessions_.size(); }
+    const auto& session(std::size_t idx) const { return *sessions_[idx]; }
+    auto& session(std::size_t idx) { return *sessions_[idx]; }
+
+    // frame arena stats summed over all sessions
+    auto frame_stats() const {
+      memory::frame_stats_t total{};
+      for (const auto& session : sessions_) {
+        const auto& stats = session->frame_arena().stats();
+        total.frames_in_use += stats.frames_in_use;
+        total.bytes_in_use += stats.bytes_in_use;
+        total.peak_bytes_in_use += stats.peak_bytes_in_use;
+        total.bytes_reserved += stats.bytes_reserved;
+        total.total_frames += stats.total_frames;
+      }
+      return total;
+    }
+
+    // Drive every session until step returns false for it. step is called
+    // as bool(session_type&) and should process a bounded quantum of
+    // messages (typically a handful of send_msg calls) before returning
+    // true, so that long-running sessions can be rebalanced. The calling
+    // thread participates as worker 0. Blocks until all sessions are done.
+    template <typename StepFn>
+    run_stats_t run(StepFn step) {
+      std::vector<queue_t> queues(num_workers_);
+      for (std::size_t idx{}; idx < sessions_.size(); ++idx) {
+        queues[idx % num_workers_].items.push_back(sessions_[idx].get());
+      }
+      std::vector<run_stats_t> stats(num_workers_);
+      std::atomic<std::size_t> remaining{sessions_.size()};
+      {
+        std::vector<std::jthread> threads;
+        threads.reserve(num_workers_ - 1);
+        for (unsigned worker{1}; worker < num_workers_; ++worker) {
+          threads.emplace_back([&, worker] {
+            work(worker, queues, remaining, stats[worker], step);
+          });
+        }
+        work(0, queues, remaining, stats[0], step);
+      }
+      run_stats_t total{};
+      for (const auto& s : stats) {
+        total.steps += s.steps;
+        total.steals += s.steals;
+      }
+      log::info("engine::run() workers:{} sessions:{} steps:{} steals:{}",
+          num_workers_, sessions_.size(), total.steps, total.steals);
+      return total;
+    }
+
+  private:
+    // A mutex-guarded deque. Steps are coarse (a quantum of messages), so
+    // queue operations are rare relative to the work they schedule.
+    struct alignas(64) queue_t {
+      std::mutex mutex;
+      std::deque<session_type*> items;
+
+      session_type* pop_front() {
+        std::lock_guard lock{mutex};
+        if (items.empty()) return nullptr;
+        auto session = items.front();
+        items.pop_front();
+        return session;
+      }
+
+      session_type* steal_back() {
+        std::lock_guard lock{mutex};
+        if (items.empty()) return nullptr;
+        auto session = items.back();
+        items.pop_back();
+        return session;
+      }
+
+      void push_back(session_type* session) {
+        std::lock_guard lock{mutex};
+        items.push_back(session);
+      }
+    };  // queue_t
+
+    template <typename StepFn>
+    void work(unsigned worker, std::vector<queue_t>& queues,
+        std::atomic<std::size_t>& remaining, run_stats_t& stats,
+        StepFn& step) {
+      auto& own = queues[worker];
+      while (remaining.load(std::memory_order_acquire)) {
+        auto session = own.pop_front();
+        if (!session) {
+          session = steal(worker, queues);
+          if (!session) {
+            std::this_thread::yield();
+            continue;
+          }
+          ++stats.steals;
+        }
+        ++stats.steps;
+        if (step(*session)) {
+          own.push_back(session);
+        } else {
+          remaining.fetch_sub(1, std::memory_order_acq_rel);
+        }
+      }
+    }
+
+    session_type* steal(unsigned worker, std::vector<queue_t>& queues) {
+      for (unsigned offset{1}; offset < num_workers_; ++offset) {
+        auto victim = (worker + offset) % num_workers_;
+        if (auto session = queues[victim].steal_back()) return session;
+      }
+      return nullptr;
+    }
+
+    unsigned num_workers_;
+    std::vector<std::unique_ptr<session_type>> sessions_;
+  };  // engine::engine_t
+}  // namespace cope::engine
+
+#endif  // INCLUDE_COPE_ENGINE_H
@@ -0,0 +1,355 @@
+// cope_event.h
+
+#pragma once
+
+#ifndef INCLUDE_COPE_EVENT_H
+#define INCLUDE_COPE_EVENT_H
+
+#ifndef __linux__
+#error "cope_event.h requires Linux (epoll, timerfd, eventfd)"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <system_error>
+#include <utility>
+#include <variant>
+#include <vector>
+#include "cope_txn.h"
+#include "internal/cope_log.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+// An epoll event loop, and awaitables that suspend a transaction until a
+// timer fires or a file descriptor becomes readable.
+//
+// A manager returns one of the awaitables from get_awaiter(), like a
+// start_awaitable. The txn suspends, and send_msg() returns with the
+// context's out message set to std::monostate. loop_t::run() then waits
+// for the event, resumes the txn, and hands the out message the txn
+// produced next to a callback. Don't send a context messages while its
+// active txn is suspended on an event.
+//
+// All timers share one timerfd, armed for the earliest deadline; an
+// eventfd wakes the loop from other threads for stop().
+//
+// A task may be destroyed while its txn is suspended on an event: the
+// awaitable, which lives in the txn's frame, removes itself from the
+// loop, which must outlive it. But not from within an on_out callback,
+// since the event may be among those run_once() has yet to resume.
+namespace cope::event {
+  using clock_type = std::chrono::steady_clock;
+
+  template <txn::Context ContextT>
+  class loop_t;
+
+  namespace detail {
+    // The loop's handle on a suspended txn. While it is registered with a
+    // loop, loop is set, and destroying it cancels its event.
+    template <txn::Context ContextT>
+    struct waiter_t {
+      using handle_type = typename ContextT::handle_type;
+
+      ~waiter_t() {
+        if (loop) loop->cancel(*this);
+      }
+
+      handle_type handle{};
+      loop_t<ContextT>* loop{};
+      int fd{-1};  // the fd awaited by a reader
+    };
+
+    inline void check(int rc, const char* what) {
+      if (rc < 0) {
+        cope::detail::fatal<std::system_error>(errno, std::system_category(),
+            what);
+      }
+    }
+  }  // namespace detail
+
+  // event::loop_t
+  //
+  // Drives the txns of contexts of one type that are suspended on event
+  // awaitables. Not thread-safe, apart from stop().
+  template <txn::Context ContextT>
+  class loop_t {
+  public:
+    using context_type = ContextT;
+    using out_msg_type = context_type::out_msg_type;
+    using waiter_type = detail::waiter_t<context_type>;
+
+    loop_t()
+        : epoll_fd_(::epoll_create1(EPOLL_CLOEXEC)),
+          timer_fd_(::timerfd_create(
+              CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+          wake_fd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+      detail::check(epoll_fd_, "epoll_create1");
+      detail::check(timer_fd_, "timerfd_create");
+      detail::check(wake_fd_, "eventfd");
+      watch(timer_fd_, EPOLLIN, &timer_fd_);
+      watch(wake_fd_, EPOLLIN, &wake_fd_);
+    }
+    loop_t(const loop_t&) = delete;
+    loop_t& operator=(const loop_t&) = delete;
+    ~loop_t() {
+      ::close(wake_fd_);
+      ::close(timer_fd_);
+      ::close(epoll_fd_);
+    }
+
+    // Resume waiter's txn at deadline.
+    void add_timer(clock_type::time_point deadline, waiter_type& waiter) {
+      timers_.push_back({deadline, timer_seq_++, &waiter});
+      std::push_heap(timers_.begin(), timers_.end(), std::greater<>{});
+      waiter.loop = this;
+      // an expired deadline is picked up by the next run_once() without
+      // arming the timerfd
+      if ((deadline < armed_) && (deadline > clock_type::now())) {
+        arm_timer(deadline);
+      }
+      ++num_waiting_;
+    }
+
+    // Resume waiter's txn when fd is readable.
+    void add_reader(int fd, waiter_type& waiter) {
+      watch(fd, EPOLLIN | EPOLLONESHOT, &waiter);
+      waiter.loop = this;
+      waiter.fd = fd;
+      ++num_waiting_;
+    }
+
+    // Forget waiter, whose txn is being destroyed without being resumed.
+    // Linear in the number of timers.
+    void cancel(waiter_type& waiter) noexcept {
+      if (waiter.fd >= 0) {
+        // fails harmlessly if fd has already been closed
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, waiter.fd, nullptr);
+      } else {
+        auto it = std::find_if(timers_.begin(), timers_.end(),
+            [&waiter](const auto& timer) { return timer.waiter == &waiter; });
+        if (it != timers_.end()) {
+          timers_.erase(it);
+          std::make_heap(timers_.begin(), timers_.end(), std::greater<>{});
+        }
+      }
+      waiter.loop = nullptr;
+      --num_waiting_;
+    }
+
+    // Wait for at least one event, for up to timeout, then resume the txn
+    // of each event that fired and call on_out(context, context.out()).
+    // Returns the number of txns resumed.
+    template <typename OutFn>
+    std::size_t run_once(OutFn&& on_out,
+        std::optional<std::chrono::milliseconds> timeout = std::nullopt) {
+      // a timer that has already expired needs no syscall to detect
+      auto resumed = resume_expired(on_out);
+      const int timeout_ms = resumed ? 0
+                             : timeout ? (int)timeout->count()
+                                       : -1;
+      epoll_event events[kMaxEvents];
+      const int count = ::epoll_wait(epoll_fd_, events, kMaxEvents,
+          timeout_ms);
+      if ((count < 0) && (errno != EINTR)) detail::check(count, "epoll_wait");
+      for (int idx{}; idx < count; ++idx) {
+        auto ptr = events[idx].data.ptr;
+        if (ptr == &timer_fd_) {
+          drain(timer_fd_);
+          armed_ = clock_type::time_point::max();
+          resumed += resume_expired(on_out);
+        } else if (ptr == &wake_fd_) {
+          drain(wake_fd_);
+        } else {
+          resume(*static_cast<waiter_type*>(ptr), on_out);
+          ++resumed;
+        }
+      }
+      return resumed;
+    }
+
+    // run_once() until no txn is waiting, or stop() is called.
+    template <typename OutFn>
+    void run(OutFn&& on_out) {
+      stopped_.store(false, std::memory_order_relaxed);
+      while (num_waiting_ && !stopped_.load(std::memory_order_relaxed)) {
+        run_once(on_out);
+      }
+    }
+
+    // Make run() return; callable from any thread.
+    void stop() {
+      stopped_.store(true, std::memory_order_relaxed);
+      const std::uint64_t one{1};
+      [[maybe_unused]] auto rc = ::write(wake_fd_, &one, sizeof(one));
+    }
+
+    // number of txns suspended on this loop
+    std::size_t num_waiting() const { return num_waiting_; }
+
+  private:
+    static constexpr int kMaxEvents{64};
+
+    struct pending_t {
+      clock_type::time_point deadline;
+      std::uint64_t seq;  // FIFO among equal deadlines
+      waiter_type* waiter;
+
+      bool operator>(const pending_t& other) const {
+        return std::pair{deadline, seq} > std::pair{other.deadline, other.seq};
+      }
+    };
+
+    void watch(int fd, std::uint32_t events, void* ptr) {
+      epoll_event ev{};
+      ev.events = events;
+      ev.data.ptr = ptr;
+      // a ONESHOT fd stays registered, disabled, after it fires
+      if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        if (errno != EEXIST) detail::check(-1, "epoll_ctl");
+        detail::check(::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev),
+            "epoll_ctl");
+      }
+    }
+
+    // Arms the timerfd for deadline. A timer left armed for a deadline
+    // whose waiter has since been resumed just wakes the loop once.
+    void arm_timer(clock_type::time_point deadline) {
+      using namespace std::chrono;
+      // steady_clock is CLOCK_MONOTONIC; 0 would disarm the timer
+      auto ns = std::max<std::int64_t>(1,
+          duration_cast<nanoseconds>(deadline.time_since_epoch()).count());
+      itimerspec spec{};
+      spec.it_value.tv_sec = (time_t)(ns / 1'000'000'000);
+      spec.it_value.tv_nsec = (long)(ns % 1'000'000'000);
+      detail::check(::timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec,
+                        nullptr), "timerfd_settime");
+      armed_ = deadline;
+    }
+
+    static void drain(int fd) {
+      std::uint64_t count;
+      [[maybe_unused]] auto rc = ::read(fd, &count, sizeof(count));
+    }
+
+    template <typename OutFn>
+    std::size_t resume_expired(OutFn& on_out) {
+      if (timers_.empty()) return 0;
+      std::size_t resumed{};
+      const auto now = clock_type::now();
+      while (!timers_.empty() && (timers_.front().deadline <= now)) {
+        auto& waiter = *timers_.front().waiter;
+        std::pop_heap(timers_.begin(), timers_.end(), std::greater<>{});
+        timers_.pop_back();
+        resume(waiter, on_out);
+        ++resumed;
+      }
+      if (!timers_.empty() && (timers_.front().deadline < armed_)) {
+        arm_timer(timers_.front().deadline);
+      }
+      return resumed;
+    }
+
+    template <typename OutFn>
+    void resume(waiter_type& waiter, OutFn& on_out) {
+      --num_waiting_;
+      waiter.loop = nullptr;
+      auto& context = waiter.handle.promise().context();
+      context.bind_txn(waiter.handle.promise());
+      // NB: waiter is destroyed when the txn resumes
+      waiter.handle.resume();
+      on_out(context, std::as_const(context.out()));
+    }
+
+    int epoll_fd_;
+    int timer_fd_;
+    int wake_fd_;
+    // a min-heap on (deadline, seq); a vector, so cancel() can remove
+    // from it
+    std::vector<pending_t> timers_;
+    std::uint64_t timer_seq_{};
+    clock_type::time_point armed_{clock_type::time_point::max()};
+    std::size_t num_waiting_{};
+    std::atomic<bool> stopped_{};
+  };  // event::loop_t
+
+  namespace detail {
+    template <txn::Context ContextT>
+    struct event_awaitable
+        : txn::detail::basic_awaiter<typename ContextT::promise_type>,
+          waiter_t<ContextT> {
+      using base_type =
+          txn::detail::basic_awaiter<typename ContextT::promise_type>;
+      using handle_type = typename ContextT::handle_type;
+
+      void suspend(handle_type h) {
+        base_type::await_suspend(h);
+        this->handle = h;
+        log::info("task_id:{} suspending on event", h.promise().txn_id());
+        h.promise().probe().await_begin();
+        h.promise().set_suspended_on_event(true);
+        h.promise().context().out() = std::monostate{};
+      }
+
+      auto& await_resume() {
+        log::info("task_id:{} resuming from event",
+            this->promise().txn_id());
+        this->promise().probe().await_end();
+        this->promise().set_suspended_on_event(false);
+        return this->promise();
+      }
+    };
+  }  // namespace detail
+
+  // event::sleep_awaitable
+  //
+  // Suspends the awaiting txn for a duration.
+  template <txn::Context ContextT>
+  struct sleep_awaitable : detail::event_awaitable<ContextT> {
+    using handle_type = typename ContextT::handle_type;
+
+    sleep_awaitable() = default;
+    sleep_awaitable(loop_t<ContextT>& loop, clock_type::duration delay)
+        : loop_(&loop), delay_(delay) {}
+
+    void await_suspend(handle_type h) {
+      this->suspend(h);
+      loop_->add_timer(clock_type::now() + delay_, *this);
+    }
+
+  private:
+    loop_t<ContextT>* loop_{};
+    clock_type::duration delay_{};
+  };  // event::sleep_awaitable
+
+  // event::readable_awaitable
+  //
+  // Suspends the awaiting txn until fd is readable. The txn reads it.
+  template <txn::Context ContextT>
+  struct readable_awaitable : detail::event_awaitable<ContextT> {
+    using handle_type = typename ContextT::handle_type;
+
+    readable_awaitable() = default;
+    readable_awaitable(loop_t<ContextT>& loop, int fd)
+        : loop_(&loop), fd_(fd) {}
+
+    void await_suspend(handle_type h) {
+      this->suspend(h);
+      loop_->add_reader(fd_, *this);
+    }
+
+  private:
+    loop_t<ContextT>* loop_{};
+    int fd_{-1};
+  };  // event::readable_awaitable
+}  // namespace cope::event
+
+#endif  // INCLUDE_COPE_EVENT_H
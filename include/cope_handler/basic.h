@@ -7,6 +7,28 @@
 #include "../internal/cope_log.h"
 
 namespace cope::txn {
+  namespace detail {
+    // The awaiter a manager's get_awaiter() fills in: the awaiter itself if
+    // awaiter_types has one element, otherwise an empty variant_awaitable
+    // of all of them, which get_awaiter() must assign one to.
+    template <typename TupleT>
+    struct awaiter_for;
+
+    template <typename AwaiterT>
+    struct awaiter_for<std::tuple<AwaiterT>> {
+      using type = AwaiterT;
+    };
+
+    template <typename... AwaiterTs>
+    requires (sizeof...(AwaiterTs) > 1)
+    struct awaiter_for<std::tuple<AwaiterTs...>> {
+      using type = variant_awaitable<AwaiterTs...>;
+    };
+
+    template <typename TupleT>
+    using awaiter_for_t = awaiter_for<TupleT>::type;
+  }  // namespace detail
+
   template <typename StateT, Context ContextT>
   struct basic_manager_t {
     using state_type = StateT;
@@ -25,10 +47,8 @@ namespace cope::txn {
 
     template <typename T>
     cope::result_t get_awaiter(context_type&, const state_type&, T&) {
-      cope::log::error("get_awaiter");
-      throw new std::runtime_error("get_awaiter");
-      // TODO:
-      // return result_code::e_fail; // e_unhandled_awaiter_type
+      cope::log::error("get_awaiter(): unhandled awaiter type");
+      return result_code::e_fail;
     }
   };  // struct manager_t
 
@@ -36,27 +56,47 @@ namespace cope::txn {
       template <typename> typename ManagerT, Context ContextT>
   // TODO: BasicManager concept requires:
   //   awaiter_types, update_state, get_yield_msg, get_awaiter
-  //   only 1 element in awaiter_types
+  // and optionally deadline(const state_type&)
   auto basic_handler(ContextT& context, id_t) -> NoContextTaskT<ContextT> {
     using task_type = NoContextTaskT<ContextT>;
     using manager_type = ManagerT<ContextT>;
     using state_type = task_type::state_type;
     using receive_txn = receive_awaitable<task_type>;
-    using awaiter_types = manager_type::awaiter_types;
+    using awaiter_type = detail::awaiter_for_t<
+        typename manager_type::awaiter_types>;
 
     state_type state;
     manager_type mgr{context};
 
     while (true) {
       auto& promise = co_await receive_txn{state};
-      auto& context = promise.context();
       /*
       const auto error = [&context](result_code rc) {
         return context.set_result(rc).failed();
       };
       */
 
-      while (!context.result().unexpected()) {
+      bool started{true};
+      if constexpr (requires { mgr.deadline(state); }) {
+        // std::optional<duration>; the txn is aborted if it runs longer
+        if (auto timeout = mgr.deadline(state)) {
+          auto result =
+              promise.set_deadline(timer::clock_type::now() + *timeout);
+          if (result.failed()) {
+            promise.context().set_result(result);
+            started = false;
+          }
+        }
+      }
+
+      while (started && !promise.context().result().unexpected()) {
+        // fetched after every suspension, since the txn may have been
+        // rebound to another context; see context_t::rebind_txn()
+        auto& context = promise.context();
+        if (promise.txn_aborted()) {
+          context.set_result(result_code::e_abort);
+          break;
+        }
         // TODO: ? see examples/txsellitems.cpp
         // if (error(msg::validate(context.in()))) break;
         auto result = mgr.update_state(context, state);
@@ -68,12 +108,20 @@ namespace cope::txn {
         if (*result == operation::yield) {
           co_yield mgr.get_yield_msg(state);
         } else if (*result == operation::await) {
-          typename std::tuple_element<0, awaiter_types>::type awaiter;
-          if constexpr (!std::is_same_v<decltype(awaiter), std::monostate>) {
-            // TODO: error handling
-            if (mgr.get_awaiter(context, state, awaiter).succeeded()) {
-              co_await awaiter;
+          awaiter_type awaiter;
+          if constexpr (!std::is_same_v<awaiter_type, std::monostate>) {
+            auto rc = mgr.get_awaiter(context, state, awaiter);
+            if constexpr (requires { awaiter.empty(); }) {
+              if (!rc.failed() && awaiter.empty()) {
+                rc = cope::detail::fail(result_code::e_fail,
+                    "get_awaiter(): no awaiter assigned");
+              }
+            }
+            if (rc.failed()) {
+              context.set_result(rc);
+              break;
             }
+            co_await awaiter;
           }
         } else {
           break;  // operation::complete
@@ -0,0 +1,142 @@
+// cope_intern.h
+
+#pragma once
+
+#ifndef INCLUDE_COPE_INTERN_H
+#define INCLUDE_COPE_INTERN_H
+
+#include <array>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <format>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Interned strings for message payloads and txn state. A string is stored
+// once, in a symbol table, and messages carry a 4-byte symbol_t handle to
+// it, so comparing two names is one integer compare and copying a message
+// copies no string data.
+//
+// Symbol ids are local to a process; cope::wire encodes a symbol as its
+// string, and interns it when decoding.
+namespace cope::intern {
+  // intern::symbol_t
+  //
+  // A handle to a string in a table_t. Two symbols from the same table are
+  // equal if and only if their strings are. The default symbol is the
+  // empty string.
+  struct symbol_t {
+    std::uint32_t id{};
+
+    friend bool operator==(symbol_t, symbol_t) = default;
+    friend auto operator<=>(symbol_t, symbol_t) = default;
+  };
+
+  // intern::table_t
+  //
+  // Thread-safe. intern() of a new string takes an exclusive lock; all
+  // other calls take a shared one, so resolve symbols to strings at the
+  // edges (logging, display), not on the hot path.
+  class table_t {
+  public:
+    table_t() { intern({}); }
+    table_t(const table_t&) = delete;
+    table_t& operator=(const table_t&) = delete;
+
+    // The symbol for str, added to the table if it isn't there.
+    symbol_t intern(std::string_view str) {
+      if (auto sym = find(str)) return *sym;
+      std::unique_lock lock{mutex_};
+      // another thread may have added it between the locks
+      if (auto it = index_.find(str); it != index_.end()) {
+        return {it->second};
+      }
+      const auto id = (std::uint32_t)strings_.size();
+      // deque elements don't move, so the index can key on them
+      const auto& stored = strings_.emplace_back(str);
+      index_.emplace(stored, id);
+      return {id};
+    }
+
+    // The symbol for str, if it has been interned.
+    std::optional<symbol_t> find(std::string_view str) const {
+      std::shared_lock lock{mutex_};
+      auto it = index_.find(str);
+      if (it == index_.end()) return std::nullopt;
+      return symbol_t{it->second};
+    }
+
+    // The string of a symbol from this table. It stays valid for the
+    // table's lifetime.
+    std::string_view str(symbol_t sym) const {
+      std::shared_lock lock{mutex_};
+      return strings_.at(sym.id);
+    }
+
+    std::size_t size() const {
+      std::shared_lock lock{mutex_};
+      return strings_.size();
+    }
+
+  private:
+    mutable std::shared_mutex mutex_;
+    std::deque<std::string> strings_;
+    std::unordered_map<std::string_view, std::uint32_t> index_;
+  };  // intern::table_t
+
+  // The process-wide table, shared by all messages and states.
+  inline table_t& symbols() {
+    static table_t table;
+    return table;
+  }
+
+  inline symbol_t intern(std::string_view str) {
+    return symbols().intern(str);
+  }
+
+  inline std::string_view str(symbol_t sym) { return symbols().str(sym); }
+
+  // intern(), through a small per-thread cache of recently interned
+  // strings that spares the table's lock when a few strings recur, as
+  // when decoding a table of rows.
+  inline symbol_t intern_recent(std::string_view str) {
+    struct entry_t {
+      std::string_view str;  // in the table, so valid for its lifetime
+      symbol_t sym;
+    };
+    // value-initialized entries map "" to the empty symbol, which is right
+    thread_local std::array<entry_t, 8> cache{};
+    thread_local std::size_t next{};
+    for (const auto& entry : cache) {
+      if (entry.str == str) return entry.sym;
+    }
+    const auto sym = intern(str);
+    cache[next++ % cache.size()] = {intern::str(sym), sym};
+    return sym;
+  }
+}  // namespace cope::intern
+
+template <>
+struct std::hash<cope::intern::symbol_t> {
+  std::size_t operator()(cope::intern::symbol_t sym) const noexcept {
+    return std::hash<std::uint32_t>{}(sym.id);
+  }
+};
+
+template <>
+struct std::formatter<cope::intern::symbol_t>
+    : std::formatter<std::string_view> {
+  auto format(cope::intern::symbol_t sym, format_context& ctx) const {
+    return std::formatter<std::string_view>::format(
+        cope::intern::str(sym), ctx);
+  }
+};
+
+#endif  // INCLUDE_COPE_INTERN_H
@@ -0,0 +1,158 @@
+// cope_memory.h
+
+#pragma once
+
+#ifndef INCLUDE_COPE_MEMORY_H
+#define INCLUDE_COPE_MEMORY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+// Define COPE_FRAME_ARENA=1 to allocate the coroutine frames of a context's
+// tasks from its frame arena, if it has one; see
+// txn::context_t::set_frame_arena(). Each frame then carries a header that
+// records its arena. Otherwise frames come from the global heap, without a
+// header, and a context's arena is unused.
+#ifndef COPE_FRAME_ARENA
+#define COPE_FRAME_ARENA 0
+#endif
+
+namespace cope::memory {
+  struct frame_stats_t {
+    std::size_t frames_in_use{};
+    std::size_t bytes_in_use{};
+    std::size_t peak_bytes_in_use{};
+    std::size_t bytes_reserved{};
+    std::size_t total_frames{};
+  };
+
+  // memory::frame_arena_t
+  //
+  // A slab pool for coroutine frames. Frames are bump-allocated from large
+  // chunks so that the frames of one transaction tree sit next to each
+  // other, and freed frames are kept on per-size free lists for reuse by
+  // the next frame of the same size. Chunks are only returned to the heap
+  // when the arena is destroyed.
+  //
+  // Not thread-safe. The arena must outlive every frame allocated from it.
+  class frame_arena_t {
+  public:
+    static constexpr std::size_t kAlignment{__STDCPP_DEFAULT_NEW_ALIGNMENT__};
+    static constexpr std::size_t kDefaultChunkSize{4096};
+
+    explicit frame_arena_t(std::size_t chunk_size = kDefaultChunkSize)
+        : chunk_size_(chunk_size) {}
+
+    frame_arena_t(const frame_arena_t&) = delete;
+    frame_arena_t& operator=(const frame_arena_t&) = delete;
+
+    void* allocate(std::size_t size) {
+      size = round_up(size);
+      auto& list = free_list(size);
+      void* ptr = list.head;
+      if (ptr) {
+        list.head = list.head->next;
+      } else {
+        ptr = bump(size);
+      }
+      stats_.frames_in_use++;
+      stats_.total_frames++;
+      stats_.bytes_in_use += size;
+      stats_.peak_bytes_in_use =
+          std::max(stats_.peak_bytes_in_use, stats_.bytes_in_use);
+      return ptr;
+    }
+
+    void deallocate(void* ptr, std::size_t size) noexcept {
+      size = round_up(size);
+      auto& list = free_list(size);
+      auto node = static_cast<free_node_t*>(ptr);
+      node->next = list.head;
+      list.head = node;
+      stats_.frames_in_use--;
+      stats_.bytes_in_use -= size;
+    }
+
+    const auto& stats() const { return stats_; }
+
+  private:
+    struct free_node_t {
+      free_node_t* next;
+    };
+
+    struct free_list_t {
+      std::size_t size;
+      free_node_t* head;
+    };
+
+    static constexpr std::size_t round_up(std::size_t size) {
+      return (size + kAlignment - 1) & ~(kAlignment - 1);
+    }
+
+    // A handful of distinct frame sizes exist per program, so a linear
+    // scan of a small vector beats any map here. allocate() creates the
+    // list for a size, so deallocate() never grows the vector.
+    free_list_t& free_list(std::size_t size) {
+      for (auto& list : free_lists_) {
+        if (list.size == size) return list;
+      }
+      return free_lists_.emplace_back(free_list_t{size, nullptr});
+    }
+
+    void* bump(std::size_t size) {
+      if (size > chunk_remaining_) {
+        auto chunk_size = std::max(chunk_size_, size);
+        chunks_.emplace_back(new std::byte[chunk_size]);
+        chunk_next_ = chunks_.back().get();
+        chunk_remaining_ = chunk_size;
+        stats_.bytes_reserved += chunk_size;
+      }
+      auto ptr = chunk_next_;
+      chunk_next_ += size;
+      chunk_remaining_ -= size;
+      return ptr;
+    }
+
+    std::size_t chunk_size_;
+    std::vector<std::unique_ptr<std::byte[]>> chunks_;
+    std::byte* chunk_next_{};
+    std::size_t chunk_remaining_{};
+    std::vector<free_list_t> free_lists_;
+    frame_stats_t stats_;
+  };  // memory::frame_arena_t
+
+#if COPE_FRAME_ARENA
+  namespace detail {
+    // Every frame is prefixed with the arena it came from (nullptr for the
+    // global heap), since operator delete does not see the coroutine's
+    // arguments. The header preserves the default new alignment.
+    struct alignas(frame_arena_t::kAlignment) frame_header_t {
+      frame_arena_t* arena;
+    };
+  }  // namespace detail
+
+  inline void* allocate_frame(frame_arena_t* arena, std::size_t size) {
+    using detail::frame_header_t;
+    size += sizeof(frame_header_t);
+    void* ptr = arena ? arena->allocate(size) : ::operator new(size);
+    auto header = ::new (ptr) frame_header_t{arena};
+    return header + 1;
+  }
+
+  inline void deallocate_frame(void* frame, std::size_t size) noexcept {
+    using detail::frame_header_t;
+    auto header = static_cast<frame_header_t*>(frame) - 1;
+    size += sizeof(frame_header_t);
+    if (auto arena = header->arena) {
+      arena->deallocate(header, size);
+    } else {
+      ::operator delete(header, size);
+    }
+  }
+#endif
+}  // namespace cope::memory
+
+#endif  // INCLUDE_COPE_MEMORY_H
@@ -3,6 +3,11 @@
 #ifndef INCLUDE_COPE_MSG_H
 #define INCLUDE_COPE_MSG_H
 
+#include <type_traits>
+#include <variant>
+#include "cope_msg_registry.h"
+#include "cope_proxy.h"
+#include "cope_result.h"
 #include "tuple.h"
 
 namespace cope {
@@ -19,12 +24,90 @@ namespace cope {
       using in_concat_type = tuple::concat_t<typename Ts::in_tuple_t...>;
       using in_tuple_type = tuple::distinct_t<in_concat_type>;
       using in_msg_type = tuple::to_variant_t<in_tuple_type>;
+      using in_registry_type = registry_t<in_tuple_type>;
 
       using out_concat_type = tuple::concat_t<std::tuple<std::monostate>,
         typename Ts::out_tuple_t...>;
       using out_tuple_type = tuple::distinct_t<out_concat_type>;
       using out_msg_type = tuple::to_variant_t<out_tuple_type>;
+      using out_registry_type = registry_t<out_tuple_type>;
     }; // type_bundle_t
+
+    namespace detail {
+      template <typename T, typename VariantT>
+      struct has_alternative : std::false_type {};
+
+      template <typename T, typename... Ts>
+      struct has_alternative<T, std::variant<Ts...>>
+          : std::bool_constant<(std::is_same_v<T, Ts> || ...)> {};
+
+      template <typename T, typename VariantT>
+      inline constexpr bool has_alternative_v =
+          has_alternative<T, VariantT>::value;
+
+      // specialized for msg::compact_variant_t in cope_msg_compact.h
+      template <typename VariantT>
+      struct is_compact_variant : std::false_type {};
+
+      template <typename VariantT>
+      inline constexpr bool is_compact_variant_v =
+          is_compact_variant<std::remove_const_t<VariantT>>::value;
+
+      template <typename T, typename VariantT>
+      auto get_exact_if(VariantT& var) {
+        if constexpr (is_compact_variant_v<VariantT>) {
+          return var.template get_if<T>();
+        } else {
+          return std::get_if<T>(&var);
+        }
+      }
+    } // namespace detail
+
+    // Storage-agnostic access to a context's in/out messages, which are
+    // std::variants or, with a compact_type_bundle_t, compact_variant_ts.
+    template <typename T, typename VariantT>
+    auto& get(VariantT& var) {
+      auto msg = detail::get_exact_if<T>(var);
+      if (!msg) cope::detail::fatal<std::bad_variant_access>();
+      return *msg;
+    }
+
+    template <typename FnT, typename VariantT>
+    decltype(auto) visit(FnT&& fn, VariantT&& var) {
+      if constexpr (detail::is_compact_variant_v<
+                        std::remove_reference_t<VariantT>>) {
+        return std::forward<VariantT>(var).visit(std::forward<FnT>(fn));
+      } else {
+        return std::visit(std::forward<FnT>(fn), std::forward<VariantT>(var));
+      }
+    }
+
+    // Returns a pointer to the T held by var, either by value or through a
+    // proxy::raw_ptr_t or proxy::unique_ptr_t, or nullptr if var holds some
+    // other message.
+    template <typename T, typename VariantT>
+    const T* get_if(const VariantT& var) {
+      using detail::has_alternative_v;
+      if constexpr (has_alternative_v<T, VariantT>) {
+        if (auto msg = detail::get_exact_if<T>(var)) return msg;
+      }
+      if constexpr (has_alternative_v<proxy::raw_ptr_t<T>, VariantT>) {
+        if (auto msg = detail::get_exact_if<proxy::raw_ptr_t<T>>(var)) {
+          return &msg->get();
+        }
+      }
+      if constexpr (has_alternative_v<proxy::unique_ptr_t<T>, VariantT>) {
+        if (auto msg = detail::get_exact_if<proxy::unique_ptr_t<T>>(var)) {
+          return &msg->get();
+        }
+      }
+      return nullptr;
+    }
+
+    template <typename T, typename VariantT>
+    bool holds(const VariantT& var) {
+      return get_if<T>(var) != nullptr;
+    }
   } // namespace msg
 } // namespace cope
 
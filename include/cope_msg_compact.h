@@ -0,0 +1,284 @@
+// cope_msg_compact.h
+
+#pragma once
+
+#ifndef INCLUDE_COPE_MSG_COMPACT_H
+#define INCLUDE_COPE_MSG_COMPACT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include "cope_msg.h"
+#include "tuple.h"
+
+namespace cope::msg {
+  // msg::compact_variant_t
+  //
+  // Alternative storage for a context's in/out messages. A std::variant is
+  // as large as its largest alternative, so a bundle with one big
+  // start_txn_t makes every message slot big. Here messages of up to
+  // kInlineSize bytes are stored inline; larger ones are stored in a
+  // single out-of-line buffer, allocated the first time a large message
+  // is stored and reused by every large message after that. Switching
+  // between small messages never touches the large buffer. Moving a large
+  // message's variant moves only its buffer, and leaves the moved-from
+  // variant empty.
+  //
+  // The tag is the message's index in Ts, and fits in a byte for bundles
+  // of fewer than 255 types. visit() dispatches through a table of
+  // per-type functions generated from Ts.
+  //
+  // Supports the subset of std::variant that contexts and transactions
+  // use; access it through the storage-agnostic msg::get(), msg::get_if()
+  // and msg::visit().
+  template <typename... Ts>
+  class compact_variant_t {
+    using first_type = std::tuple_element_t<0, std::tuple<Ts...>>;
+
+  public:
+    static constexpr std::size_t kInlineSize{32};
+    static constexpr std::size_t kInlineAlign{alignof(std::max_align_t)};
+
+    using tag_type = std::conditional_t<(sizeof...(Ts) < 255), std::uint8_t,
+        std::uint16_t>;
+
+    template <typename T>
+    static constexpr bool is_alternative = (std::is_same_v<T, Ts> || ...);
+
+    template <typename T>
+    static constexpr bool is_inline =
+        (sizeof(T) <= kInlineSize) && (alignof(T) <= kInlineAlign);
+
+    template <typename T>
+    requires is_alternative<T>
+    static constexpr std::size_t index_of = [] {
+      constexpr bool matches[]{std::is_same_v<T, Ts>...};
+      return (std::size_t)(std::find(std::begin(matches), std::end(matches),
+                               true) - std::begin(matches));
+    }();
+
+    compact_variant_t() { emplace<first_type>(); }
+
+    compact_variant_t(const compact_variant_t& other) { assign(other); }
+    compact_variant_t(compact_variant_t&& other) noexcept(
+        (std::is_nothrow_move_constructible_v<Ts> && ...)) {
+      take(std::move(other));
+    }
+
+    template <typename T>
+    requires is_alternative<std::remove_cvref_t<T>>
+    compact_variant_t(T&& msg) {
+      emplace<std::remove_cvref_t<T>>(std::forward<T>(msg));
+    }
+
+    ~compact_variant_t() {
+      reset();
+      if (heap_) ::operator delete(heap_, std::align_val_t{kHeapAlign});
+    }
+
+    compact_variant_t& operator=(const compact_variant_t& other) {
+      if (this != &other) assign(other);
+      return *this;
+    }
+
+    compact_variant_t& operator=(compact_variant_t&& other) noexcept(
+        ((std::is_nothrow_move_constructible_v<Ts>
+             && std::is_nothrow_move_assignable_v<Ts>) && ...)) {
+      if (this != &other) take(std::move(other));
+      return *this;
+    }
+
+    template <typename T>
+    requires is_alternative<std::remove_cvref_t<T>>
+    compact_variant_t& operator=(T&& msg) {
+      using msg_type = std::remove_cvref_t<T>;
+      if (auto held = get_if<msg_type>()) {
+        *held = std::forward<T>(msg);
+      } else {
+        emplace<msg_type>(std::forward<T>(msg));
+      }
+      return *this;
+    }
+
+    template <typename T, typename... Args>
+    requires is_alternative<T>
+    T& emplace(Args&&... args) {
+      reset();
+      auto msg = ::new (slot<T>()) T(std::forward<Args>(args)...);
+      tag_ = (tag_type)index_of<T>;
+      return *msg;
+    }
+
+    std::size_t index() const {
+      return tag_ == kNoTag ? std::variant_npos : tag_;
+    }
+
+    template <typename T>
+    bool holds() const { return tag_ == index_of<T>; }
+
+    template <typename T>
+    T* get_if() { return holds<T>() ? ptr<T>() : nullptr; }
+
+    template <typename T>
+    const T* get_if() const { return holds<T>() ? ptr<T>() : nullptr; }
+
+    template <typename FnT>
+    decltype(auto) visit(FnT&& fn) { return dispatch(fn, *this); }
+
+    template <typename FnT>
+    decltype(auto) visit(FnT&& fn) const { return dispatch(fn, *this); }
+
+  private:
+    static constexpr tag_type kNoTag{std::numeric_limits<tag_type>::max()};
+
+    template <typename T>
+    static constexpr std::size_t heap_size() {
+      return is_inline<T> ? 0 : sizeof(T);
+    }
+
+    template <typename T>
+    static constexpr std::size_t heap_align() {
+      return is_inline<T> ? 0 : alignof(T);
+    }
+
+    static constexpr std::size_t kHeapSize{std::max({heap_size<Ts>()...})};
+    static constexpr std::size_t kHeapAlign{std::max(
+        {std::size_t{__STDCPP_DEFAULT_NEW_ALIGNMENT__}, heap_align<Ts>()...})};
+
+    template <typename T>
+    void* slot() {
+      if constexpr (is_inline<T>) {
+        return storage_;
+      } else {
+        if (!heap_) {
+          heap_ = ::operator new(kHeapSize, std::align_val_t{kHeapAlign});
+        }
+        return heap_;
+      }
+    }
+
+    template <typename T>
+    T* ptr() {
+      return std::launder(static_cast<T*>(is_inline<T> ? (void*)storage_
+                                                        : heap_));
+    }
+
+    template <typename T>
+    const T* ptr() const {
+      return std::launder(static_cast<const T*>(
+          is_inline<T> ? (const void*)storage_ : heap_));
+    }
+
+    template <typename OtherT>
+    void assign(OtherT&& other) {
+      dispatch([this](auto&& msg) {
+        *this = std::forward<decltype(msg)>(msg);
+      }, std::forward<OtherT>(other));
+    }
+
+    // Moves an inline message; takes a large one with its buffer, leaving
+    // other empty, and gives other this one's buffer in exchange.
+    void take(compact_variant_t&& other) {
+      if (other.tag_ == kNoTag) {
+        reset();
+        return;
+      }
+      dispatch([this, &other](auto&& msg) {
+        using msg_type = std::remove_cvref_t<decltype(msg)>;
+        if constexpr (is_inline<msg_type>) {
+          *this = std::move(msg);
+        } else {
+          reset();
+          std::swap(heap_, other.heap_);
+          tag_ = std::exchange(other.tag_, kNoTag);
+        }
+      }, std::move(other));
+    }
+
+    void reset() {
+      if constexpr (!(std::is_trivially_destructible_v<Ts> && ...)) {
+        if (tag_ != kNoTag) {
+          dispatch([](auto& msg) {
+            using msg_type = std::remove_cvref_t<decltype(msg)>;
+            msg.~msg_type();
+          }, *this);
+        }
+      }
+      tag_ = kNoTag;
+    }
+
+    // FnT is an lvalue reference. SelfT is compact_variant_t& or
+    // compact_variant_t&&, possibly const.
+    template <typename T, typename FnT, typename SelfT, typename ResultT>
+    static ResultT invoke(FnT fn, SelfT& self) {
+      using msg_type = std::conditional_t<
+          std::is_const_v<std::remove_reference_t<SelfT>>, const T, T>;
+      if constexpr (std::is_rvalue_reference_v<SelfT>) {
+        return std::invoke(fn, std::move(*self.template ptr<msg_type>()));
+      } else {
+        return std::invoke(fn, *self.template ptr<msg_type>());
+      }
+    }
+
+    template <typename FnT, typename SelfT>
+    static decltype(auto) dispatch(FnT&& fn, SelfT&& self) {
+      using self_type = std::remove_reference_t<SelfT>;
+      using first_msg_type = std::conditional_t<std::is_const_v<self_type>,
+          const first_type, first_type>;
+      using arg_type = std::conditional_t<std::is_rvalue_reference_v<SelfT&&>,
+          first_msg_type&&, first_msg_type&>;
+      using fn_ref_type = std::remove_reference_t<FnT>&;
+      using result_type = std::invoke_result_t<fn_ref_type, arg_type>;
+      using fn_type = result_type (*)(fn_ref_type, self_type&);
+      static constexpr fn_type table[]{
+          &invoke<Ts, fn_ref_type, SelfT&&, result_type>...};
+      if (self.tag_ == kNoTag) cope::detail::fatal<std::bad_variant_access>();
+      return table[self.tag_](fn, self);
+    }
+
+    alignas(kInlineAlign) std::byte storage_[kInlineSize];
+    void* heap_{};
+    tag_type tag_{kNoTag};
+  };  // msg::compact_variant_t
+
+  namespace detail {
+    template <typename... Ts>
+    struct is_compact_variant<compact_variant_t<Ts...>> : std::true_type {};
+
+    template <typename T, typename... Ts>
+    struct has_alternative<T, compact_variant_t<Ts...>>
+        : std::bool_constant<(std::is_same_v<T, Ts> || ...)> {};
+
+    template <typename T>
+    struct to_compact_variant;
+
+    template <typename... Ts>
+    struct to_compact_variant<std::tuple<Ts...>> {
+      using type = compact_variant_t<Ts...>;
+    };
+  }  // namespace detail
+
+  template <typename... Ts>
+  struct registry_for<compact_variant_t<Ts...>> {
+    using type = registry_t<std::tuple<Ts...>>;
+  };
+
+  // A type_bundle_t whose context stores messages in compact_variant_ts.
+  template <typename... Ts>
+  struct compact_type_bundle_t : type_bundle_t<Ts...> {
+    using base_type = type_bundle_t<Ts...>;
+    using in_msg_type = detail::to_compact_variant<
+        typename base_type::in_tuple_type>::type;
+    using out_msg_type = detail::to_compact_variant<
+        typename base_type::out_tuple_type>::type;
+  };  // compact_type_bundle_t
+}  // namespace cope::msg
+
+#endif  // INCLUDE_COPE_MSG_COMPACT_H
@@ -0,0 +1,185 @@
+// cope_msg_registry.h
+
+#pragma once
+
+#ifndef INCLUDE_COPE_MSG_REGISTRY_H
+#define INCLUDE_COPE_MSG_REGISTRY_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <variant>
+
+namespace cope::msg {
+  using id_type = int;
+
+  // Specialize to give a message type a name and/or a numeric id:
+  //
+  //   template <> struct cope::msg::info_t<my::msg::data_t> {
+  //     static constexpr std::string_view name{"my::msg"};
+  //     static constexpr cope::msg::id_type id{1000};
+  //   };
+  //
+  // Either member may be omitted. The default name is the type's name as
+  // spelled by the compiler; the default id is a hash of the name, so it
+  // does not change when the bundle's types are reordered.
+  //
+  // A hash of a declared name is the same in every build. A hash of the
+  // compiler's spelling is per-build: it differs between compilers, and
+  // changes when the type is renamed or moved to another namespace. So a
+  // message type that is encoded by cope::wire, and so recorded by
+  // cope::trace or sent through cope::shm, must declare a name or an id;
+  // see stable_id_v.
+  template <typename T>
+  struct info_t {};
+
+  template <>
+  struct info_t<std::monostate> {
+    static constexpr std::string_view name{"empty_msg"};
+  };
+
+  namespace detail {
+    template <typename T>
+    constexpr std::string_view type_name() {
+#if defined(_MSC_VER) && !defined(__clang__)
+      std::string_view name{__FUNCSIG__};
+      constexpr std::string_view prefix{"type_name<"};
+      constexpr std::string_view suffix{">(void)"};
+      name.remove_prefix(name.find(prefix) + prefix.size());
+      name.remove_suffix(name.size() - name.rfind(suffix));
+      for (std::string_view key : {"struct ", "class ", "enum "}) {
+        if (name.starts_with(key)) name.remove_prefix(key.size());
+      }
+#else
+      std::string_view name{__PRETTY_FUNCTION__};
+      constexpr std::string_view prefix{"T = "};
+      name.remove_prefix(name.find(prefix) + prefix.size());
+      name = name.substr(0, name.find_first_of(";]"));
+#endif
+      return name;
+    }
+
+    // 31-bit FNV-1a
+    constexpr id_type hash(std::string_view str) {
+      std::uint32_t hash{2166136261u};
+      for (auto c : str) {
+        hash = (hash ^ (std::uint8_t)c) * 16777619u;
+      }
+      return (id_type)(hash & 0x7fffffff);
+    }
+  }  // namespace detail
+
+  template <typename T>
+  inline constexpr std::string_view name_of = [] {
+    if constexpr (requires { info_t<T>::name; }) {
+      return std::string_view{info_t<T>::name};
+    } else {
+      return detail::type_name<T>();
+    }
+  }();
+
+  template <typename T>
+  inline constexpr id_type id_of = [] {
+    if constexpr (requires { info_t<T>::id; }) {
+      return id_type{info_t<T>::id};
+    } else {
+      return detail::hash(name_of<T>);
+    }
+  }();
+
+  // whether id_of<T> is the same in every build; see info_t
+  template <typename T>
+  inline constexpr bool stable_id_v =
+      requires { info_t<T>::id; } || requires { info_t<T>::name; };
+
+  // msg::registry_t
+  //
+  // Names and ids of the message types in a tuple, in tuple order, so that
+  // a message variant's index() is an index into both tables.
+  template <typename TupleT>
+  struct registry_t;
+
+  template <typename... Ts>
+  struct registry_t<std::tuple<Ts...>> {
+    using tuple_type = std::tuple<Ts...>;
+
+    static constexpr std::size_t size{sizeof...(Ts)};
+    static constexpr std::array<std::string_view, size> names{name_of<Ts>...};
+    static constexpr std::array<id_type, size> ids{id_of<Ts>...};
+
+    static constexpr bool unique_ids() {
+      for (std::size_t i{}; i < size; ++i) {
+        for (std::size_t j{i + 1}; j < size; ++j) {
+          if (ids[i] == ids[j]) return false;
+        }
+      }
+      return true;
+    }
+    static_assert(unique_ids(), "message ids in a bundle must be unique");
+
+    // (id, index) pairs sorted by id, for find()
+    static constexpr std::array<std::pair<id_type, std::size_t>, size> by_id =
+        [] {
+          std::array<std::pair<id_type, std::size_t>, size> entries{};
+          for (std::size_t idx{}; idx < size; ++idx) {
+            entries[idx] = {ids[idx], idx};
+          }
+          std::sort(entries.begin(), entries.end());
+          return entries;
+        }();
+
+    // name/id of the message held by var, a variant of Ts
+    template <typename VariantT>
+    static constexpr std::string_view name(const VariantT& var) {
+      return names[var.index()];
+    }
+
+    template <typename VariantT>
+    static constexpr id_type id(const VariantT& var) {
+      return ids[var.index()];
+    }
+
+    // index of the message type with the given id, if any
+    static constexpr std::optional<std::size_t> find(id_type id) {
+      auto it = std::lower_bound(by_id.begin(), by_id.end(), id,
+          [](const auto& entry, id_type id) { return entry.first < id; });
+      if ((it == by_id.end()) || (it->first != id)) return std::nullopt;
+      return it->second;
+    }
+
+    // index of T, which must be one of Ts
+    template <typename T>
+    static constexpr std::size_t index_of = *find(id_of<T>);
+  };  // msg::registry_t
+
+  // The registry for a message variant type; specialized for
+  // compact_variant_t in cope_msg_compact.h.
+  template <typename VariantT>
+  struct registry_for;
+
+  template <typename... Ts>
+  struct registry_for<std::variant<Ts...>> {
+    using type = registry_t<std::tuple<Ts...>>;
+  };
+
+  template <typename VariantT>
+  using registry_for_t = registry_for<VariantT>::type;
+
+  // name/id of the message held by a std::variant or compact_variant_t
+  template <typename VariantT>
+  constexpr std::string_view name(const VariantT& var) {
+    return registry_for_t<VariantT>::name(var);
+  }
+
+  template <typename VariantT>
+  constexpr id_type id(const VariantT& var) {
+    return registry_for_t<VariantT>::id(var);
+  }
+}  // namespace cope::msg
+
+#endif  // INCLUDE_COPE_MSG_REGISTRY_H
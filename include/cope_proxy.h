@@ -4,7 +4,23 @@
 #define INCLUDE_COPE_PROXY_H
 
 #include <memory>
+#include <type_traits>
 
+// Proxy messages deliver a payload without moving it through the context.
+// A type bundle lists the proxy type (e.g. raw_ptr_t<data_t>) in its
+// in_tuple_t, and the task that receives it uses it as its msg_type.
+// Transactions read the payload through msg::get_if<data_t>() regardless
+// of how it was delivered.
+//
+// Lifetime rules:
+//   raw_ptr_t    by reference. The sender keeps ownership; the referent
+//                must stay valid and unmodified until the send_msg() call
+//                that delivers it returns. Transactions must not retain
+//                the proxy, or pointers into the payload, past that step;
+//                copy whatever they need into their state.
+//   unique_ptr_t by ownership. The payload is handed over with a single
+//                pointer move and is owned by the context until the next
+//                message replaces it.
 namespace cope::proxy {
   // TODO: what if i want msg.members to be moved?
   //   maybe it just works. test it with state that deletes
@@ -26,7 +42,7 @@ namespace cope::proxy {
     void emplace(const T& msg) { msg_ = &msg; }
 
   private:
-    const T* msg_;
+    const T* msg_{};
   };
 
   template<typename T>
@@ -38,7 +54,7 @@ namespace cope::proxy {
     unique_ptr_t(const ptr_type& ptr) = delete;
     unique_ptr_t(ptr_type&& ptr) : ptr_(std::move(ptr)) {}
 
-    // const auto& get() const {}?
+    const auto& get() const { return *ptr_.get(); }
     auto& get() { return *ptr_.get(); }
     [[nodiscard]] auto&& get_moveable() { return std::move(ptr_); }
     void emplace(ptr_type&& ptr) { ptr_ = std::move(ptr); }
@@ -46,6 +62,18 @@ namespace cope::proxy {
   private:
     ptr_type ptr_;
   };
+
+  template <typename T>
+  struct is_proxy : std::false_type {};
+
+  template <typename T>
+  struct is_proxy<raw_ptr_t<T>> : std::true_type {};
+
+  template <typename T>
+  struct is_proxy<unique_ptr_t<T>> : std::true_type {};
+
+  template <typename T>
+  inline constexpr bool is_proxy_v = is_proxy<T>::value;
 } // namespace cope::proxy
 
-#endif // INCLUDE_COPE_PROXY_H
\ No newline at end of file
+#endif // INCLUDE_COPE_PROXY_H
@@ -3,9 +3,25 @@
 #ifndef INCLUDE_COPE_RESULT_H
 #define INCLUDE_COPE_RESULT_H
 
+#include <cstdlib>
 #include <format>
 #include <functional>
+#include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
+#include "internal/cope_log.h"
+
+// Library errors on the txn path are returned as result codes, in every
+// build, and a txn that fails completes with one in its context's
+// result(). Misuse that can't be reported that way, such as msg::get()
+// of a message the variant doesn't hold, throws; in exception-free mode,
+// in builds without exceptions (-fno-exceptions), it aborts.
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+#define COPE_NOEXCEPT 0
+#else
+#define COPE_NOEXCEPT 1
+#endif
 
 namespace cope {
   enum class result_code : unsigned {
@@ -37,6 +53,24 @@ namespace cope {
 
     result_code code{result_code::s_ok};
   };
+
+  namespace detail {
+    // Logs what as an error, and returns rc.
+    inline result_t fail(result_code rc, std::string_view what) {
+      log::error("{}", what);
+      return rc;
+    }
+
+    // Throws ExceptionT(args...), or in exception-free mode aborts.
+    template <typename ExceptionT, typename... Args>
+    [[noreturn]] void fatal([[maybe_unused]] Args&&... args) {
+#if COPE_NOEXCEPT
+      std::abort();
+#else
+      throw ExceptionT(std::forward<Args>(args)...);
+#endif
+    }
+  }  // namespace detail
 } // namespace cope::result
 
 template <>
@@ -0,0 +1,397 @@
+// cope_shm.h
+
+#pragma once
+
+#ifndef INCLUDE_COPE_SHM_H
+#define INCLUDE_COPE_SHM_H
+
+#ifdef _WIN32
+#error "cope_shm.h requires POSIX shared memory"
+#endif
+
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include "cope_wire.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+// Single-producer/single-consumer rings of wire frames in shared memory,
+// for feeding messages to a task from another process.
+//
+// A ring is a header followed by a power-of-two byte buffer. Frames are
+// written contiguously; a frame that doesn't fit before the end of the
+// buffer is preceded by a wrap marker and written at the start. The
+// consumer reads frames in place and releases them once it is done with
+// them, so decoding reads straight out of shared memory.
+//
+// Either end may busy-poll, for the lowest latency, or wait: spin
+// briefly, then sleep on a futex until the other end makes progress. The
+// other end only makes the wake syscall when a waiter has announced
+// itself. Without futexes (non-Linux) waiting falls back to yielding.
+namespace cope::shm {
+  enum class wait_mode {
+    busy_poll,
+    wait
+  };
+
+  namespace detail {
+    inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#elif defined(__aarch64__)
+      asm volatile("yield");
+#endif
+    }
+
+    static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t)
+                  && std::atomic<std::uint32_t>::is_always_lock_free);
+
+    inline void futex_wait(std::atomic<std::uint32_t>& word,
+        std::uint32_t expected) {
+#ifdef __linux__
+      ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word),
+          FUTEX_WAIT, expected, nullptr, nullptr, 0);
+#else
+      if (word.load() == expected) std::this_thread::yield();
+#endif
+    }
+
+    inline void futex_wake(std::atomic<std::uint32_t>& word) {
+#ifdef __linux__
+      ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word),
+          FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+      (void)word;
+#endif
+    }
+
+    // One end's position, and the futex the other end waits on for it to
+    // change. Each end's fields share a cache line that only it writes,
+    // apart from the waiting flag.
+    struct alignas(64) cursor_t {
+      std::atomic<std::uint64_t> pos;
+      std::atomic<std::uint32_t> seq;      // futex word, bumped on wake
+      std::atomic<std::uint32_t> waiting;  // the other end is asleep
+    };
+
+    struct header_t {
+      static constexpr std::uint32_t kMagic{0x434f5045};  // "COPE"
+
+      std::uint32_t magic;
+      std::uint32_t capacity;
+      std::atomic<std::uint32_t> closed;
+      cursor_t head;  // written by the producer
+      cursor_t tail;  // written by the consumer
+    };
+
+    // Announces progress: publish pos, then wake the other end if it has
+    // gone to sleep. The fence orders the store before the waiting check,
+    // pairing with the fence in wait_for().
+    inline void publish(cursor_t& cursor, std::uint64_t pos) {
+      cursor.pos.store(pos, std::memory_order_release);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (cursor.waiting.load(std::memory_order_relaxed)) {
+        cursor.seq.fetch_add(1, std::memory_order_relaxed);
+        futex_wake(cursor.seq);
+      }
+    }
+
+    // Wait until ready() is true, or the ring is closed.
+    template <typename ReadyFn>
+    bool wait_for(header_t& header, cursor_t& cursor, wait_mode mode,
+        ReadyFn&& ready) {
+      // on a single cpu the other end can't progress while we spin
+      static const int spins =
+          (std::thread::hardware_concurrency() > 1) ? 1024 : 0;
+      for (int spin{};; ++spin) {
+        if (ready()) return true;
+        if (header.closed.load(std::memory_order_acquire)) return ready();
+        if ((mode == wait_mode::busy_poll) || (spin < spins)) {
+          cpu_relax();
+          continue;
+        }
+        const auto seq = cursor.seq.load(std::memory_order_relaxed);
+        cursor.waiting.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!ready() && !header.closed.load(std::memory_order_acquire)) {
+          futex_wait(cursor.seq, seq);
+        }
+        cursor.waiting.store(0, std::memory_order_relaxed);
+      }
+    }
+
+    inline constexpr std::uint32_t kWrapTag{0xffff'ffff};
+  }  // namespace detail
+
+  // shm::segment_t
+  //
+  // A named POSIX shared memory segment, mapped read/write. The creator
+  // unlinks the name when it is destroyed; processes that opened it keep
+  // their mappings.
+  class segment_t {
+  public:
+    static segment_t create(const std::string& name, std::size_t size) {
+      return segment_t{name, size, true};
+    }
+
+    static segment_t open(const std::string& name) {
+      return segment_t{name, 0, false};
+    }
+
+    segment_t(segment_t&& other) noexcept
+        : name_(std::move(other.name_)),
+          data_(std::exchange(other.data_, nullptr)),
+          size_(std::exchange(other.size_, 0)),
+          owner_(std::exchange(other.owner_, false)) {}
+    segment_t(const segment_t&) = delete;
+    segment_t& operator=(const segment_t&) = delete;
+    ~segment_t() {
+      if (data_) ::munmap(data_, size_);
+      if (owner_) ::shm_unlink(name_.c_str());
+    }
+
+    void* data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+  private:
+    segment_t(const std::string& name, std::size_t size, bool create)
+        : name_(name), size_(size), owner_(create) {
+      const int flags = create ? (O_CREAT | O_EXCL | O_RDWR) : O_RDWR;
+      const int fd = ::shm_open(name.c_str(), flags, 0600);
+      if (fd < 0) throw std::runtime_error("shm: can't open " + name);
+      struct stat st{};
+      const bool ok = create ? (::ftruncate(fd, (off_t)size) == 0)
+                             : (::fstat(fd, &st) == 0);
+      if (!create) size_ = (std::size_t)st.st_size;
+      if (ok) {
+        data_ = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED,
+            fd, 0);
+      }
+      ::close(fd);
+      if (!ok || (data_ == MAP_FAILED)) {
+        data_ = nullptr;
+        if (create) ::shm_unlink(name.c_str());
+        throw std::runtime_error("shm: can't map " + name);
+      }
+    }
+
+    std::string name_;
+    void* data_{};
+    std::size_t size_;
+    bool owner_;
+  };  // shm::segment_t
+
+  // shm::ring_t
+  //
+  // A ring laid out in caller-provided (shared) memory of bytes_for()
+  // bytes. Construct both ends over the same memory: one producer_t and
+  // one consumer_t, in any processes that map it.
+  class ring_t {
+  public:
+    static constexpr std::size_t bytes_for(std::size_t capacity) {
+      return sizeof(detail::header_t) + capacity;
+    }
+
+    // Lay out an empty ring of capacity bytes, a power of two.
+    static ring_t create(void* memory, std::size_t capacity) {
+      if (!capacity || (capacity & (capacity - 1))
+          || (capacity > UINT32_MAX)) {
+        throw std::invalid_argument("shm: capacity must be a power of two");
+      }
+      auto header = ::new (memory) detail::header_t{};
+      header->capacity = (std::uint32_t)capacity;
+      header->magic = detail::header_t::kMagic;
+      return ring_t{memory};
+    }
+
+    // Attach to a ring another process created.
+    static ring_t attach(void* memory) {
+      if (static_cast<detail::header_t*>(memory)->magic
+          != detail::header_t::kMagic) {
+        throw std::runtime_error("shm: not a ring");
+      }
+      return ring_t{memory};
+    }
+
+    // No more frames will be sent; wakes a waiting consumer, after which
+    // receive() returns nullopt once the ring drains.
+    void close() {
+      header_->closed.store(1, std::memory_order_release);
+      for (auto cursor : {&header_->head, &header_->tail}) {
+        cursor->seq.fetch_add(1, std::memory_order_relaxed);
+        detail::futex_wake(cursor->seq);
+      }
+    }
+
+    bool closed() const {
+      return header_->closed.load(std::memory_order_acquire);
+    }
+
+    std::size_t capacity() const { return header_->capacity; }
+
+  protected:
+    explicit ring_t(void* memory)
+        : header_(static_cast<detail::header_t*>(memory)),
+          data_(reinterpret_cast<std::byte*>(header_ + 1)),
+          mask_(header_->capacity - 1) {}
+
+    detail::header_t* header_;
+    std::byte* data_;
+    std::uint64_t mask_;
+  };  // shm::ring_t
+
+  // shm::producer_t
+  //
+  // The sending end of a ring. Messages are encoded into a reused buffer
+  // and copied into the ring as one frame.
+  class producer_t : public ring_t {
+  public:
+    explicit producer_t(ring_t ring) : ring_t(ring) {
+      head_ = header_->head.pos.load(std::memory_order_relaxed);
+    }
+
+    // Send msg, a message type or message variant, if there is room.
+    template <typename T>
+    bool try_send(const T& msg) {
+      encode(msg);
+      return try_write();
+    }
+
+    // Send msg, waiting for room. Returns false if the ring was closed.
+    template <typename T>
+    bool send(const T& msg, wait_mode mode) {
+      encode(msg);
+      return detail::wait_for(*header_, header_->tail, mode,
+                 [this] { return try_write(); });
+    }
+
+  private:
+    template <typename T>
+    void encode(const T& msg) {
+      buffer_.clear();
+      wire::encode(buffer_, msg);
+      if (buffer_.size() > capacity() / 2) {
+        throw std::length_error("shm: message too large for ring");
+      }
+    }
+
+    bool has_room(std::size_t size) {
+      if (head_ + size - tail_ <= capacity()) return true;
+      tail_ = header_->tail.pos.load(std::memory_order_acquire);
+      return head_ + size - tail_ <= capacity();
+    }
+
+    bool try_write() {
+      const auto size = buffer_.size();
+      const auto offset = head_ & mask_;
+      const auto wrap = (offset + size > capacity()) ? capacity() - offset
+                                                     : 0;
+      if (!has_room(wrap + size)) return false;
+      if (wrap) {
+        std::memcpy(data_ + offset, &detail::kWrapTag, sizeof(std::uint32_t));
+        head_ += wrap;
+      }
+      std::memcpy(data_ + (head_ & mask_), buffer_.data(), size);
+      head_ += size;
+      detail::publish(header_->head, head_);
+      return true;
+    }
+
+    wire::writer_t buffer_;
+    std::uint64_t head_;
+    std::uint64_t tail_{};  // cached consumer position
+  };  // shm::producer_t
+
+  // shm::consumer_t
+  //
+  // The receiving end of a ring. A received frame points into the ring
+  // and stays valid until release().
+  class consumer_t : public ring_t {
+  public:
+    explicit consumer_t(ring_t ring) : ring_t(ring) {
+      tail_ = header_->tail.pos.load(std::memory_order_relaxed);
+      next_ = tail_;
+    }
+
+    std::optional<wire::frame_t> try_receive() {
+      if (!available()) return std::nullopt;
+      auto offset = next_ & mask_;
+      std::uint32_t tag;
+      std::memcpy(&tag, data_ + offset, sizeof(tag));
+      if (tag == detail::kWrapTag) {
+        next_ += capacity() - offset;
+        offset = 0;
+      }
+      wire::reader_t in{data_ + offset, data_ + capacity()};
+      auto frame = wire::next(in);
+      next_ += (std::uint64_t)(in.pos() - (data_ + offset));
+      return frame;
+    }
+
+    // Wait for a frame. Returns nullopt once the ring is closed and empty.
+    std::optional<wire::frame_t> receive(wait_mode mode) {
+      if (!detail::wait_for(*header_, header_->head, mode,
+              [this] { return available(); })) {
+        return std::nullopt;
+      }
+      return try_receive();
+    }
+
+    // Give the space of every frame received so far back to the producer.
+    void release() {
+      if (tail_ == next_) return;
+      tail_ = next_;
+      detail::publish(header_->tail, tail_);
+    }
+
+  private:
+    bool available() {
+      if (next_ != head_) return true;
+      head_ = header_->head.pos.load(std::memory_order_acquire);
+      return next_ != head_;
+    }
+
+    std::uint64_t tail_;    // released position
+    std::uint64_t next_;    // position of the next frame
+    std::uint64_t head_{};  // cached producer position
+  };  // shm::consumer_t
+
+  struct serve_stats_t {
+    std::uint64_t msgs{};
+  };
+
+  // Drive task from a ring: send each message received on in to the task,
+  // and send the message it produces on out, until in is closed.
+  template <typename ContextT, typename TaskT>
+  serve_stats_t serve(TaskT& task, consumer_t& in, producer_t& out,
+      wait_mode mode) {
+    serve_stats_t stats;
+    wire::sender_t<ContextT> sender;
+    while (auto frame = in.receive(mode)) {
+      const auto& reply = sender.send(task, *frame);
+      in.release();
+      if (!out.send(reply, mode)) break;
+      ++stats.msgs;
+    }
+    return stats;
+  }
+}  // namespace cope::shm
+
+#endif  // INCLUDE_COPE_SHM_H
@@ -0,0 +1,200 @@
+// cope_stats.h
+
+#pragma once
+
+#ifndef INCLUDE_COPE_STATS_H
+#define INCLUDE_COPE_STATS_H
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Per-transaction instrumentation. Define COPE_TXN_STATS=1 to have each
+// context record, per txn_id, how long transactions take from start_txn
+// to complete_txn, how many times they yield and await, and how long
+// they spend awaiting nested transactions. Otherwise the probe and the
+// registry are empty types and every hook compiles to nothing.
+#ifndef COPE_TXN_STATS
+#define COPE_TXN_STATS 0
+#endif
+
+namespace cope::stats {
+  inline constexpr bool kEnabled{COPE_TXN_STATS != 0};
+
+  // stats::histogram_t
+  //
+  // An HDR-style log-linear histogram of non-negative integer values.
+  // Values below kSubCount are counted exactly; above that, each power of
+  // two is split into kHalfCount (32) buckets, so any recorded value is
+  // reported to within 1/32 (~3%) above it. Recording is a handful of
+  // integer ops.
+  class histogram_t {
+  public:
+    static constexpr int kSubBits{6};
+    static constexpr std::uint64_t kSubCount{1u << kSubBits};
+    static constexpr std::uint64_t kHalfCount{kSubCount / 2};
+    static constexpr std::size_t kBuckets{
+        (64 - kSubBits) * kHalfCount + kSubCount};
+
+    void record(std::uint64_t value) {
+      ++counts_[bucket(value)];
+      ++count_;
+      total_ += value;
+      min_ = std::min(min_, value);
+      max_ = std::max(max_, value);
+    }
+
+    void merge(const histogram_t& other) {
+      for (std::size_t idx{}; idx < kBuckets; ++idx) {
+        counts_[idx] += other.counts_[idx];
+      }
+      count_ += other.count_;
+      total_ += other.total_;
+      min_ = std::min(min_, other.min_);
+      max_ = std::max(max_, other.max_);
+    }
+
+    void reset() { *this = histogram_t{}; }
+
+    auto count() const { return count_; }
+    auto total() const { return total_; }
+    std::uint64_t min() const { return count_ ? min_ : 0; }
+    std::uint64_t max() const { return max_; }
+    double mean() const { return count_ ? (double)total_ / count_ : 0.0; }
+
+    // The highest value equivalent to the value at percentile pct (0-100).
+    std::uint64_t percentile(double pct) const {
+      if (!count_) return 0;
+      auto target = (std::uint64_t)(std::clamp(pct, 0.0, 100.0) / 100.0
+                                    * (double)count_ + 0.5);
+      target = std::max<std::uint64_t>(target, 1);
+      std::uint64_t seen{};
+      for (std::size_t idx{}; idx < kBuckets; ++idx) {
+        seen += counts_[idx];
+        if (seen >= target) return std::min(highest_value(idx), max_);
+      }
+      return max_;
+    }
+
+  private:
+    static constexpr std::size_t bucket(std::uint64_t value) {
+      int shift = std::max(0, (int)std::bit_width(value) - kSubBits);
+      return (std::size_t)shift * kHalfCount + (value >> shift);
+    }
+
+    static constexpr std::uint64_t highest_value(std::size_t idx) {
+      if (idx < kSubCount) return idx;
+      auto shift = idx / kHalfCount - 1;
+      auto sub = idx - shift * kHalfCount;
+      return ((sub + 1) << shift) - 1;
+    }
+
+    std::array<std::uint64_t, kBuckets> counts_{};
+    std::uint64_t count_{};
+    std::uint64_t total_{};
+    std::uint64_t min_{std::numeric_limits<std::uint64_t>::max()};
+    std::uint64_t max_{};
+  };  // stats::histogram_t
+
+  // distributions for all completed transactions with one txn_id
+  struct txn_stats_t {
+    int txn_id{};
+    histogram_t duration;    // ns, start_txn to complete_txn
+    histogram_t resumes;     // yields + awaits
+    histogram_t yields;
+    histogram_t awaits;
+    histogram_t await_time;  // ns spent in nested txns, per txn
+  };
+
+#if COPE_TXN_STATS
+  // stats::txn_probe_t
+  //
+  // Per-promise counters for the transaction in progress.
+  class txn_probe_t {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    void start() {
+      yields_ = 0;
+      awaits_ = 0;
+      await_ns_ = 0;
+      start_ = clock::now();
+    }
+
+    void yield() { ++yields_; }
+
+    void await_begin() {
+      ++awaits_;
+      await_start_ = clock::now();
+    }
+
+    void await_end() { await_ns_ += ns_since(await_start_); }
+
+  private:
+    friend class txn_registry_t;
+
+    static std::uint64_t ns_since(clock::time_point start) {
+      return (std::uint64_t)std::chrono::duration_cast<
+          std::chrono::nanoseconds>(clock::now() - start).count();
+    }
+
+    clock::time_point start_;
+    clock::time_point await_start_;
+    std::uint64_t yields_{};
+    std::uint64_t awaits_{};
+    std::uint64_t await_ns_{};
+  };  // stats::txn_probe_t
+
+  // stats::txn_registry_t
+  //
+  // Per-context collection of txn_stats_t, one per txn_id.
+  class txn_registry_t {
+  public:
+    void record(int txn_id, const txn_probe_t& probe) {
+      auto& stats = find(txn_id);
+      stats.duration.record(txn_probe_t::ns_since(probe.start_));
+      stats.resumes.record(probe.yields_ + probe.awaits_);
+      stats.yields.record(probe.yields_);
+      stats.awaits.record(probe.awaits_);
+      stats.await_time.record(probe.await_ns_);
+    }
+
+    // A copy of the stats recorded so far, ordered by first completion.
+    std::vector<txn_stats_t> snapshot() const { return txns_; }
+
+    void reset() { txns_.clear(); }
+
+  private:
+    // few txn_ids per context; see memory::frame_arena_t::free_list
+    txn_stats_t& find(int txn_id) {
+      for (auto& stats : txns_) {
+        if (stats.txn_id == txn_id) return stats;
+      }
+      auto& stats = txns_.emplace_back();
+      stats.txn_id = txn_id;
+      return stats;
+    }
+
+    std::vector<txn_stats_t> txns_;
+  };  // stats::txn_registry_t
+#else
+  struct txn_probe_t {
+    void start() {}
+    void yield() {}
+    void await_begin() {}
+    void await_end() {}
+  };
+
+  struct txn_registry_t {
+    void record(int, const txn_probe_t&) {}
+    std::vector<txn_stats_t> snapshot() const { return {}; }
+    void reset() {}
+  };
+#endif  // COPE_TXN_STATS
+}  // namespace cope::stats
+
+#endif  // INCLUDE_COPE_STATS_H
@@ -0,0 +1,169 @@
+// cope_timer_wheel.h
+
+#pragma once
+
+#ifndef INCLUDE_COPE_TIMER_WHEEL_H
+#define INCLUDE_COPE_TIMER_WHEEL_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace cope::timer {
+  using clock_type = std::chrono::steady_clock;
+
+  // timer::node_t
+  //
+  // A timer, linked into a wheel_t slot while armed. Embed one in the
+  // object it times; owner is passed back on expiry.
+  struct node_t {
+    node_t() = default;
+    node_t(const node_t&) = delete;
+    node_t& operator=(const node_t&) = delete;
+    ~node_t() { unlink(); }
+
+    bool armed() const { return pprev != nullptr; }
+
+    void unlink() {
+      if (!pprev) return;
+      *pprev = next;
+      if (next) next->pprev = pprev;
+      next = nullptr;
+      pprev = nullptr;
+    }
+
+    void* owner{};
+    std::uint64_t expiry{};  // in wheel ticks
+    node_t* next{};
+    node_t** pprev{};        // the pointer that points to this node
+  };  // timer::node_t
+
+  // timer::wheel_t
+  //
+  // A hierarchical timer wheel: kLevels wheels of kSlots slots, each slot
+  // a list of the timers that expire in it. Level 0 slots are one tick
+  // wide, and each level's slots are kSlots times wider than the level
+  // below. A timer is armed into the lowest level whose span covers it,
+  // and moves down a level each time the level above turns over, so arm()
+  // and cancel() are O(1) however many timers are armed. Timers further
+  // out than the top level's span wait in its last slot and are
+  // re-armed as it turns over.
+  class wheel_t {
+  public:
+    static constexpr int kSlotBits{6};
+    static constexpr std::size_t kSlots{1 << kSlotBits};
+    static constexpr int kLevels{4};
+
+    explicit wheel_t(clock_type::duration tick = std::chrono::milliseconds{1},
+        clock_type::time_point start = clock_type::now())
+        : tick_(tick), start_(start) {}
+    wheel_t(const wheel_t&) = delete;
+    wheel_t& operator=(const wheel_t&) = delete;
+    ~wheel_t() {
+      for (auto& level : slots_) {
+        for (auto& head : level) {
+          while (head) head->unlink();
+        }
+      }
+    }
+
+    // the first tick at or after time
+    std::uint64_t tick_at(clock_type::time_point time) const {
+      if (time <= start_) return 0;
+      return (std::uint64_t)((time - start_ + tick_ - clock_type::duration{1})
+                             / tick_);
+    }
+
+    // the start of tick
+    clock_type::time_point time_at(std::uint64_t tick) const {
+      return start_ + (clock_type::rep)tick * tick_;
+    }
+
+    // Arm node to expire at time, re-arming it if it's armed. A time that
+    // has already passed expires on the next tick.
+    void arm(node_t& node, clock_type::time_point time) {
+      node.unlink();
+      node.expiry = tick_at(time);
+      insert(node);
+      ++size_;
+    }
+
+    void cancel(node_t& node) {
+      if (!node.armed()) return;
+      node.unlink();
+      --size_;
+    }
+
+    // Advance to time, calling on_expired(node) for each timer that
+    // expires, in tick order. on_expired may arm and cancel timers.
+    template <typename FnT>
+    std::size_t advance(clock_type::time_point time, FnT&& on_expired) {
+      const auto target = tick_at(time);
+      std::size_t expired{};
+      while (now_ < target) {
+        if (!size_) {
+          now_ = target;
+          break;
+        }
+        ++now_;
+        if (!(now_ & kMask)) cascade(1);
+        auto& head = slots_[0][now_ & kMask];
+        while (head) {
+          auto& node = *head;
+          node.unlink();
+          --size_;
+          ++expired;
+          on_expired(node);
+        }
+      }
+      return expired;
+    }
+
+    std::size_t size() const { return size_; }
+    std::uint64_t now() const { return now_; }
+
+  private:
+    static constexpr std::uint64_t kMask{kSlots - 1};
+
+    void insert(node_t& node) {
+      auto expiry = (node.expiry > now_) ? node.expiry : now_ + 1;
+      const auto delta = expiry - now_;
+      int level{};
+      while ((level < kLevels - 1)
+             && (delta >= (std::uint64_t{1} << (kSlotBits * (level + 1))))) {
+        ++level;
+      }
+      const auto max_delta = std::uint64_t{1} << (kSlotBits * kLevels);
+      if (delta >= max_delta) expiry = now_ + max_delta - 1;
+      auto& head = slots_[level][(expiry >> (kSlotBits * level)) & kMask];
+      node.next = head;
+      if (head) head->pprev = &node.next;
+      node.pprev = &head;
+      head = &node;
+    }
+
+    // re-arm the timers in level's current slot into the levels below
+    void cascade(int level) {
+      const auto idx = (now_ >> (kSlotBits * level)) & kMask;
+      if (!idx && (level + 1 < kLevels)) cascade(level + 1);
+      auto head = slots_[level][idx];
+      slots_[level][idx] = nullptr;
+      while (head) {
+        auto node = head;
+        head = node->next;
+        node->pprev = nullptr;
+        node->next = nullptr;
+        insert(*node);
+      }
+    }
+
+    clock_type::duration tick_;
+    clock_type::time_point start_;
+    std::uint64_t now_{};
+    std::size_t size_{};
+    std::array<std::array<node_t*, kSlots>, kLevels> slots_{};
+  };  // timer::wheel_t
+}  // namespace cope::timer
+
+#endif  // INCLUDE_COPE_TIMER_WHEEL_H
@@ -0,0 +1,301 @@
+// cope_trace.h
+
+#pragma once
+
+#ifndef INCLUDE_COPE_TRACE_H
+#define INCLUDE_COPE_TRACE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "cope_msg.h"
+#include "cope_msg_registry.h"
+#include "cope_wire.h"
+#include "internal/cope_log.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Binary record/replay of the messages sent to and produced by a task.
+//
+// A trace is a 16-byte header, "COPETRC" '\0', u32 version, u32 reserved,
+// followed by one wire frame (see cope_wire.h) per message. Out messages'
+// frame tags have kOutTag set. Frames carry registry ids rather than
+// bundle indices, so a trace stays readable when the bundle's types are
+// reordered, and by a build from another compiler, since every recorded
+// message type declares its name or id; see msg::info_t.
+//
+// Payloads are encoded by wire::codec_t<T>; specialize it for message and
+// state types that have no built-in codec.
+namespace cope::trace {
+  inline constexpr std::array<char, 8> kMagic{'C', 'O', 'P', 'E', 'T', 'R',
+      'C', '\0'};
+  inline constexpr std::uint32_t kVersion{2};
+  inline constexpr std::uint32_t kOutTag{0x8000'0000};
+
+  // trace::writer_t
+  //
+  // Buffered, append-only file output of whole frames.
+  class writer_t {
+  public:
+    static constexpr std::size_t kBufferSize{64 * 1024};
+
+    explicit writer_t(const std::string& path)
+        : file_(std::fopen(path.c_str(), "wb")) {
+      if (!file_) throw std::runtime_error("trace: can't create " + path);
+    }
+    writer_t(const writer_t&) = delete;
+    writer_t& operator=(const writer_t&) = delete;
+    // Closes the file if close() wasn't called, logging, rather than
+    // throwing, an error.
+    ~writer_t() {
+      if (!file_) return;
+      try {
+        close();
+      } catch (const std::exception& e) {
+        log::error("{}", e.what());
+      }
+    }
+
+    // the buffer to encode into; call done() after each frame
+    wire::writer_t& buffer() { return buffer_; }
+
+    void done() {
+      if (buffer_.size() >= kBufferSize) flush();
+    }
+
+    void flush() {
+      if (!buffer_.size()) return;
+      if (!file_) throw std::runtime_error("trace: write after close");
+      if (std::fwrite(buffer_.data(), 1, buffer_.size(), file_)
+          != buffer_.size()) {
+        throw std::runtime_error("trace: write failed");
+      }
+      buffer_.clear();
+    }
+
+    // Flush and close the file; throws if either fails. Call it to learn
+    // whether the whole trace was written.
+    void close() {
+      if (!file_) return;
+      auto file = file_;
+      try {
+        flush();
+      } catch (...) {
+        file_ = nullptr;
+        std::fclose(file);
+        throw;
+      }
+      file_ = nullptr;
+      if (std::fclose(file)) throw std::runtime_error("trace: close failed");
+    }
+
+  private:
+    std::FILE* file_;
+    wire::writer_t buffer_;
+  };  // trace::writer_t
+
+  namespace detail {
+    // A read-only memory mapping of a whole file.
+    class mapped_file_t {
+    public:
+      explicit mapped_file_t(const std::string& path) {
+#ifdef _WIN32
+        file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        LARGE_INTEGER size{};
+        if ((file_ == INVALID_HANDLE_VALUE) || !GetFileSizeEx(file_, &size)) {
+          release();
+          throw std::runtime_error("trace: can't open " + path);
+        }
+        size_ = (std::size_t)size.QuadPart;
+        if (size_) {
+          mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0,
+              nullptr);
+          data_ = mapping_ ? MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0)
+                           : nullptr;
+        }
+#else
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        struct stat st{};
+        if ((fd_ < 0) || (::fstat(fd_, &st) < 0)) {
+          release();
+          throw std::runtime_error("trace: can't open " + path);
+        }
+        size_ = (std::size_t)st.st_size;
+        if (size_) {
+          data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+          if (data_ == MAP_FAILED) data_ = nullptr;
+          else ::madvise(data_, size_, MADV_SEQUENTIAL);
+        }
+#endif
+        if (size_ && !data_) {
+          release();
+          throw std::runtime_error("trace: can't map " + path);
+        }
+      }
+      mapped_file_t(const mapped_file_t&) = delete;
+      mapped_file_t& operator=(const mapped_file_t&) = delete;
+      ~mapped_file_t() { release(); }
+
+      const std::byte* begin() const {
+        return static_cast<const std::byte*>(data_);
+      }
+      const std::byte* end() const { return begin() + size_; }
+
+    private:
+      // Unmaps and closes whatever has been mapped and opened; the
+      // destructor doesn't run when the constructor throws.
+      void release() noexcept {
+#ifdef _WIN32
+        if (data_) UnmapViewOfFile(data_);
+        if (mapping_) CloseHandle(mapping_);
+        if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+#else
+        if (data_) ::munmap(data_, size_);
+        if (fd_ >= 0) ::close(fd_);
+#endif
+      }
+
+#ifdef _WIN32
+      HANDLE file_{INVALID_HANDLE_VALUE};
+      HANDLE mapping_{};
+#else
+      int fd_{-1};
+#endif
+      void* data_{};
+      std::size_t size_{};
+    };  // mapped_file_t
+  }  // namespace detail
+
+  // trace::recorder_t
+  //
+  // Records every message sent to a task through send_msg(), and the out
+  // message each one produced.
+  template <typename ContextT>
+  class recorder_t {
+  public:
+    using in_msg_type = ContextT::in_msg_type;
+    using out_msg_type = ContextT::out_msg_type;
+
+    explicit recorder_t(const std::string& path) : out_(path) {
+      auto& buffer = out_.buffer();
+      buffer.write(kMagic.data(), kMagic.size());
+      buffer.put(kVersion);
+      buffer.put(std::uint32_t{});
+    }
+
+    // task.send_msg(msg), recording msg and the out msg it produced
+    template <typename TaskT, typename T>
+    decltype(auto) send_msg(TaskT& task, T&& msg) {
+      record(msg);
+      decltype(auto) out = task.send_msg(std::forward<T>(msg));
+      record_out(out);
+      return out;
+    }
+
+    // record msg, a message type or in_msg_type
+    template <typename T>
+    void record(const T& msg) {
+      wire::encode(out_.buffer(), msg);
+      done();
+    }
+
+    void record_out(const out_msg_type& out) {
+      msg::visit([this](const auto& m) {
+        using T = std::remove_cvref_t<decltype(m)>;
+        wire::encode_as(out_.buffer(), wire::tag_of<T>() | kOutTag, m);
+      }, out);
+      done();
+    }
+
+    void flush() { out_.flush(); }
+    void close() { out_.close(); }
+
+    std::size_t num_records() const { return num_records_; }
+
+  private:
+    void done() {
+      out_.done();
+      ++num_records_;
+    }
+
+    writer_t out_;
+    std::size_t num_records_{};
+  };  // trace::recorder_t
+
+  struct replay_stats_t {
+    std::size_t in_msgs{};
+    std::size_t out_msgs{};
+    std::size_t out_mismatches{};  // out msg type differs from the trace
+  };
+
+  // trace::replayer_t
+  //
+  // Memory-maps a trace and sends its in messages to a task through a
+  // wire::sender_t, so replay does not allocate per message.
+  template <typename ContextT>
+  class replayer_t {
+  public:
+    using in_msg_type = ContextT::in_msg_type;
+    using out_msg_type = ContextT::out_msg_type;
+
+    explicit replayer_t(const std::string& path) : file_(path) {
+      wire::reader_t in{file_.begin(), file_.end()};
+      std::array<char, kMagic.size()> magic{};
+      in.read(magic.data(), magic.size());
+      if ((magic != kMagic) || (in.get<std::uint32_t>() != kVersion)) {
+        throw std::runtime_error("trace: not a trace file: " + path);
+      }
+      in.get<std::uint32_t>();
+      frames_ = in.pos();
+    }
+
+    // Send every in message in the trace to task, in order.
+    template <typename TaskT>
+    replay_stats_t replay(TaskT& task) {
+      replay_stats_t stats;
+      wire::reader_t in{frames_, file_.end()};
+      std::optional<msg::id_type> out_expected;
+      while (auto frame = wire::next(in)) {
+        if (frame->tag & kOutTag) {
+          if (out_expected.has_value()) {
+            stats.out_mismatches +=
+                ((msg::id_type)(frame->tag & ~kOutTag) != *out_expected);
+            out_expected.reset();
+          }
+          ++stats.out_msgs;
+          continue;
+        }
+        const auto& out = sender_.send(task, *frame);
+        out_expected = msg::id(out);
+        ++stats.in_msgs;
+      }
+      return stats;
+    }
+
+  private:
+    detail::mapped_file_t file_;
+    const std::byte* frames_{};
+    wire::sender_t<ContextT> sender_;
+  };  // trace::replayer_t
+}  // namespace cope::trace
+
+#endif  // INCLUDE_COPE_TRACE_H
@@ -8,15 +8,27 @@
 #include <coroutine>
 #include <format>
 #include <memory>
-#include <optional>
+#include <span>
 #include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 #include <variant>
+#include <vector>
+#include "cope_memory.h"
 #include "cope_msg.h"
 #include "cope_result.h"
+#include "cope_stats.h"
+#include "cope_timer_wheel.h"
 #include "internal/cope_log.h"
 #include "traits.h"
 
+// noexcept in exception-free mode; see cope_result.h
+#if COPE_NOEXCEPT
+#define NOEXCEPT noexcept
+#else
 #define NOEXCEPT
+#endif
 
 namespace cope::txn {
   enum class id_t : int {};
@@ -79,6 +91,7 @@ namespace cope::txn {
 
     private:
       using out_msg_type = context_type::out_msg_type;
+      using slot_type = context_type::slot_t;
       using promise_type = promise<context_type>;
       using yield_awaiter = detail::basic_awaiter<promise_type>;
       using handle_type = std::coroutine_handle<promise_type>;
@@ -99,12 +112,28 @@ namespace cope::txn {
     public:
       promise() = delete;
       promise(context_type& context, id_t task_id) NOEXCEPT :
-        context_(context), txn_id_(task_id) {}
+        context_(&context), txn_id_(task_id) {}
+      promise(const promise&) = delete;
+      promise& operator=(const promise&) = delete;
+      ~promise() { cancel_deadline(); }
+
+#if COPE_FRAME_ARENA
+      // frames are allocated from the context's frame arena, if it has one
+      static void* operator new(std::size_t size, context_type& context, id_t) {
+        return memory::allocate_frame(context.frame_arena(), size);
+      }
+      static void operator delete(void* ptr, std::size_t size) noexcept {
+        memory::deallocate_frame(ptr, size);
+      }
+#endif
 
       auto get_return_object() noexcept { return this; }
       initial_awaiter initial_suspend() noexcept { return {}; }
       std::suspend_always final_suspend() noexcept { return {}; }
       void unhandled_exception() {
+#if COPE_NOEXCEPT
+        std::terminate();  // unreachable
+#else
         log::info("task_id:{} *** unhandled_exception ***", txn_id());
         try {
           std::rethrow_exception(std::current_exception());
@@ -114,12 +143,17 @@ namespace cope::txn {
           // something?
           throw;
         }
+#endif
+      }
+      void return_void() {
+        cope::detail::fatal<std::runtime_error>("co_return not allowed");
       }
-      void return_void() { throw std::runtime_error("co_return not allowed"); }
 
-      yield_awaiter yield_value(out_msg_type&& msg) {
-        log::info("task_id:{} yielding {}", txn_id(), context().msg_name(msg));
+      yield_awaiter yield_value(out_msg_type&& msg) NOEXCEPT {
+        log::info("task_id:{} yielding {}", txn_id(),
+          log::lazy([&] { return context().msg_name(msg); }));
         context().out() = std::move(msg);
+        probe_.yield();
         return {};
       }
 
@@ -132,23 +166,84 @@ namespace cope::txn {
       void set_txn_status(status txn_status) {
         txn_status_ = txn_status;
         log::info("task_id:{} set_txn_status({})", txn_id_, txn_status_);
+        if (txn_status == status::running) {
+          aborted_ = false;
+          probe_.start();
+        } else if (txn_status == status::complete) {
+          cancel_deadline();
+          context().txn_stats().record((int)txn_id_, probe_);
+        }
+      }
+
+      // Abort the running txn if it hasn't completed by time; see
+      // txn::expire_deadlines(). Requires a context deadline wheel.
+      // Completing the txn cancels its deadline.
+      result_t set_deadline(timer::clock_type::time_point time) {
+        auto wheel = context().deadline_wheel();
+        if (!wheel) {
+          return cope::detail::fail(result_code::e_fail,
+              std::format("task_id:{} set_deadline(): no deadline wheel",
+                  txn_id()));
+        }
+        deadline_.owner = this;
+        wheel->arm(deadline_, time);
+        return {};
+      }
+      void cancel_deadline() {
+        if (deadline_.armed()) context().deadline_wheel()->cancel(deadline_);
       }
 
-      const auto& context() const { return context_; }
-      auto& context() { return context_; }
+      // An aborted txn completes with result_code::e_abort the next time
+      // it resumes.
+      bool txn_aborted() const { return aborted_; }
+      void abort_txn() { aborted_ = true; }
+
+      // set while suspended on an event::loop_t awaitable, which alone
+      // may resume it
+      bool suspended_on_event() const { return suspended_on_event_; }
+      void set_suspended_on_event(bool value) { suspended_on_event_ = value; }
+
+      // the context slot of the txn tree this txn runs in, if it has been
+      // started as a nested txn or routed; see context_t::add_txn()
+      auto txn_slot() const { return txn_slot_; }
+      void set_txn_slot(slot_type* slot) { txn_slot_ = slot; }
+
+      // no-ops unless COPE_TXN_STATS
+      auto& probe() { return probe_; }
+
+      const auto& context() const { return *context_; }
+      auto& context() { return *context_; }
+
+      // Binds the txn to context; see context_t::rebind_txn(). An armed
+      // deadline moves to context's deadline wheel, which it must have.
+      void set_context(context_type& context) {
+        if (&context == context_) return;
+        auto wheel = context_->deadline_wheel();
+        if (deadline_.armed() && (context.deadline_wheel() != wheel)) {
+          const auto time = wheel->time_at(deadline_.expiry);
+          wheel->cancel(deadline_);
+          context.deadline_wheel()->arm(deadline_, time);
+        }
+        context_ = &context;
+      }
 
-      auto prev_handle() const { return prev_handle_; }
-      void set_prev_handle(handle_type h) { prev_handle_.emplace(h); }
+      bool deadline_armed() const { return deadline_.armed(); }
 
     private:
-      ContextT& context_;
+      ContextT* context_;
+      slot_type* txn_slot_{};
       id_t txn_id_;
       status txn_status_{status::ready};
-      std::optional<handle_type> prev_handle_;
+      bool aborted_{};
+      bool suspended_on_event_{};
+      timer::node_t deadline_;
+      [[no_unique_address]] stats::txn_probe_t probe_;
     }; // promise_type
 
-    inline constexpr auto default_msg_name_fn = [](const auto&) -> std::string {
-      return "msg";
+    // names from the bundle's msg::registry_t; see msg::info_t
+    inline constexpr auto default_msg_name_fn =
+        [](const auto& msg) -> std::string_view {
+      return msg::name_of<std::remove_cvref_t<decltype(msg)>>;
     };
   }  // namespace detail
 
@@ -182,27 +277,50 @@ namespace cope::txn {
 
     template<typename T>
     // TODO: requires in_tuple_type contains Msg
-    [[nodiscard]] decltype(auto) send_msg(T&& msg) {
+    [[nodiscard]] decltype(auto) send_msg(T&& msg) NOEXCEPT {
       //validate_send_msg<(msg);
+      context().bind_txn(promise());
       context().in() = std::move(msg);
       log::info("sending {} to task_id:{}",
-        context().msg_name(context().in()),
+        log::lazy([this] { return context().msg_name(context().in()); }),
         active_handle().promise().txn_id());
       active_handle().resume();
       //
       // NB: active_handle() may have changed at this point
       //
       log::info("received {} from task_id:{}",
-        context().msg_name(context().out()),
+        log::lazy([this] { return context().msg_name(context().out()); }),
         active_handle().promise().txn_id());
       return context().out();
     }
 
-    static void complete_txn(promise_type& promise) {
+    // Send each message in msgs, in order, moving the out msg produced by
+    // each one to out. Equivalent to calling send_msg() once per message,
+    // without the per-message logging or a caller round-trip between
+    // resumes. Returns the advanced output iterator.
+    template <typename T, std::size_t Extent, typename OutputIt>
+    OutputIt send_msgs(std::span<T, Extent> msgs, OutputIt out) NOEXCEPT {
+      context().bind_txn(promise());
+      log::info("sending {} msgs to task_id:{}", msgs.size(),
+        active_handle().promise().txn_id());
+      for (auto& msg : msgs) {
+        context().in() = std::move(msg);
+        // NB: active_handle() may change on every resume
+        active_handle().resume();
+        *out++ = std::move(context().out());
+      }
+      log::info("sent {} msgs, active task_id:{}", msgs.size(),
+        active_handle().promise().txn_id());
+      return out;
+    }
+
+    // Completes the txn, with the context's result. A txn that isn't
+    // running completes with result_code::e_unexpected.
+    static void complete_txn(promise_type& promise) NOEXCEPT {
       if (!promise.txn_running()) {
-        // TODO: nasty place to throw. need to figure out error handling.
-        log::info("complete_txn(): txn is not running");
-        throw std::runtime_error("txn::complete(): txn is not running");
+        promise.context().set_result(
+            cope::detail::fail(result_code::e_unexpected,
+                "txn::complete(): txn is not running"));
       }
       if (promise.context().result().failed()) {
         log::info("ERROR task_id:{} completing with code: {}", promise.txn_id(),
@@ -234,34 +352,290 @@ namespace cope::txn {
     context_t(MsgNameFnT& msg_name_fn = detail::default_msg_name_fn)
       : msg_name_fn_(msg_name_fn) {}
 
-    auto active_handle() const { return active_handle_; }
+    context_t(const context_t&) = delete;
+    context_t& operator=(const context_t&) = delete;
+
+    auto active_handle() const { return slot_->active_handle; }
     void set_active_handle(handle_type h) {
       cope::log::info("task_id:{} set_active", h.promise().txn_id());
-      active_handle_ = h;
+      slot_->active_handle = h;
     }
 
-    operator result_t& () { return result_; }
-    auto result() const { return result_; }
-    auto set_result(result_code rc) { result_.code = rc; return result_; }
+    // Nested txns. start_awaitable pushes the awaiting txn's handle and
+    // activates the nested one; when the nested txn completes, its parent
+    // is popped and reactivated. Both are O(1) at any depth, and the
+    // stack's storage is reused once it has grown to the deepest nesting.
+    void push_active_handle(handle_type h) {
+      slot_->txn_stack.push_back(slot_->active_handle);
+      // a nested txn runs in its parent's context and tree, which may
+      // have been rebound since it last ran
+      h.promise().set_context(*this);
+      h.promise().set_txn_slot(slot_);
+      set_active_handle(h);
+    }
+    handle_type pop_active_handle() {
+      auto h = slot_->txn_stack.back();
+      slot_->txn_stack.pop_back();
+      set_active_handle(h);
+      return h;
+    }
+    // number of txns suspended awaiting a nested txn
+    auto txn_depth() const { return slot_->txn_stack.size(); }
+
+    // Coroutine frames for tasks created on this context are allocated from
+    // arena, if COPE_FRAME_ARENA is set; see cope_memory.h. Must be set
+    // before any task is created on the context, and the arena must
+    // outlive those tasks.
+    auto frame_arena() const { return frame_arena_; }
+    void set_frame_arena(memory::frame_arena_t* arena) { frame_arena_ = arena; }
+
+    // Txn deadlines are armed in wheel, which may be shared by contexts of
+    // this type; see txn::expire_deadlines(). Must be set before a
+    // deadline is set, and must outlive the context's tasks.
+    auto deadline_wheel() const { return deadline_wheel_; }
+    void set_deadline_wheel(timer::wheel_t* wheel) { deadline_wheel_ = wheel; }
+
+    // Per-txn_id latency histograms, if built with COPE_TXN_STATS; see
+    // cope_stats.h.
+    const auto& txn_stats() const { return txn_stats_; }
+    auto& txn_stats() { return txn_stats_; }
+
+    operator result_t& () { return slot_->result; }
+    auto result() const { return slot_->result; }
+    auto set_result(result_code rc) {
+      slot_->result.code = rc;
+      return slot_->result;
+    }
 
     constexpr auto& in() const { return in_; }
     auto& in() { return in_; }
-    const auto& out() const { return out_; }
-    auto& out() { return out_; }
+    const auto& out() const { return slot_->out; }
+    auto& out() { return slot_->out; }
+
+    // Multi-txn mode. A context can run many independent txn trees at
+    // once, each with its own active handle, nested txn stack, result and
+    // out msg, in a slot_t. add_txn() routes messages for the id of a
+    // root txn to its tree, and send_msg(id, msg) resumes that tree's
+    // active txn with msg. result() and out() are those of the tree that
+    // last resumed. A tree's task may send it messages too, and the
+    // context's own tree can be used alongside routed ones. Slots are
+    // found through a table indexed by txn id, so routed ids should be
+    // small and dense.
+    result_t add_txn(handle_type root) {
+      const auto id = root.promise().txn_id();
+      if ((int)id < 0) {
+        return cope::detail::fail(result_code::e_unexpected_txn_id,
+            std::format("add_txn(): txn_id:{} is negative", id));
+      }
+      if ((std::size_t)id >= routes_.size()) routes_.resize((int)id + 1);
+      auto& slot = routes_[(int)id];
+      if (slot) {
+        return cope::detail::fail(result_code::e_unexpected_txn_id,
+            std::format("add_txn(): txn_id:{} is already routed", id));
+      }
+      slot = std::make_unique<slot_t>();
+      slot->active_handle = root;
+      root.promise().set_txn_slot(slot.get());
+      // the root's initial_awaiter may have made it the default active txn
+      if (own_.active_handle == root) own_.active_handle = {};
+      return {};
+    }
+
+    // Stop routing messages for id. Its tree must not be awaiting a nested
+    // txn. Remove a tree before destroying its task.
+    result_t remove_txn(id_t id) {
+      auto slot = find_txn(id);
+      if (!slot) return result_code::e_unexpected_txn_id;
+      if (!slot->txn_stack.empty()) {
+        return cope::detail::fail(result_code::e_fail,
+            std::format("remove_txn(): txn_id:{} is awaiting a nested txn",
+                id));
+      }
+      slot->active_handle.promise().set_txn_slot(nullptr);
+      if (slot_ == slot) slot_ = &own_;
+      routes_[(int)id].reset();
+      return {};
+    }
+
+    bool has_txn(id_t id) const { return find_txn(id) != nullptr; }
+
+    // whether the last send_msg(id, msg) found a tree for id
+    result_t route_result() const { return route_result_; }
+
+    // Route msg to the txn tree of root txn id, and return the out msg it
+    // produced. If no tree is routed for id, the msg is dropped, the out
+    // msg is std::monostate and route_result() is
+    // result_code::e_unexpected_txn_id; no tree's result() changes.
+    template <typename T>
+    const out_msg_type& send_msg(id_t id, T&& msg) NOEXCEPT {
+      static const out_msg_type no_out{};
+      auto slot = find_txn(id);
+      if (!slot) {
+        log::info("send_msg(): txn_id:{} is not routed", id);
+        route_result_ = result_code::e_unexpected_txn_id;
+        return no_out;
+      }
+      route_result_ = {};
+      slot_ = slot;
+      in_ = std::forward<T>(msg);
+      log::info("sending {} to txn_id:{}",
+          log::lazy([this] { return msg_name(in_); }), id);
+      slot->active_handle.resume();
+      log::info("received {} from txn_id:{}",
+          log::lazy([this] { return msg_name(slot_->out); }), id);
+      return slot->out;
+    }
+
+    // Make the slot of promise's txn tree current, before resuming a txn
+    // other than through send_msg(), e.g. from an event loop. A txn with
+    // no slot is the root of the context's own tree.
+    void bind_txn(const promise_type& promise) {
+      auto slot = promise.txn_slot();
+      slot_ = slot ? slot : &own_;
+    }
+
+    // Move the txn tree of root from the context it is bound to, of this
+    // type, to this one: to migrate a session to a context run by another
+    // thread, say. What moves is the tree's active txn and the txns that
+    // await it, down to root, with the tree's out msg and result, and any
+    // deadline they have armed, to this context's deadline wheel. Other
+    // txns of the tree are rebound when they are next started. A routed
+    // tree is routed by the same id here; any other becomes this
+    // context's own tree, and this context must not have one already.
+    //
+    // Call it between messages, when none of the tree's txns is running
+    // and neither context is in use by another thread; afterwards, send
+    // the tree messages only through this context. A tree whose active
+    // txn is suspended on an event can't move. Coroutine frames stay
+    // where they are, and frames from a frame arena are freed to it, so
+    // the arena must outlive the tree and be used by one thread at a
+    // time: give each session an arena of its own, as engine::session_t
+    // does. Managers must not keep the context they were constructed with.
+    result_t rebind_txn(handle_type root) {
+      auto& src = root.promise().context();
+      if (&src == this) return {};
+      const auto id = root.promise().txn_id();
+      auto routed = src.find_txn(id);
+      if (routed != root.promise().txn_slot()) routed = nullptr;
+      auto& src_slot = routed ? *routed : src.own_;
+      if ((src_slot.active_handle != root)
+          && (src_slot.txn_stack.empty()
+              || (src_slot.txn_stack.front() != root))) {
+        return cope::detail::fail(result_code::e_fail,
+            std::format("rebind_txn(): txn_id:{} is not the root of a "
+                        "txn tree", id));
+      }
+      if (src_slot.active_handle.promise().suspended_on_event()) {
+        return cope::detail::fail(result_code::e_fail,
+            std::format("rebind_txn(): txn_id:{} is suspended on an event",
+                src_slot.active_handle.promise().txn_id()));
+      }
+      if (!deadline_wheel_ && has_deadline(src_slot)) {
+        return cope::detail::fail(result_code::e_fail,
+            "rebind_txn(): armed deadline and no deadline wheel");
+      }
+      if (routed ? (find_txn(id) != nullptr)
+                 : (own_.active_handle || !own_.txn_stack.empty())) {
+        return cope::detail::fail(result_code::e_unexpected_txn_id,
+            std::format("rebind_txn(): context already has a tree for "
+                        "txn_id:{}", id));
+      }
+      log::info("task_id:{} rebinding txn tree, depth:{}", id,
+          src_slot.txn_stack.size());
+
+      slot_t* slot = routed;
+      if (routed) {
+        // the slot itself moves, so routed promises' slots stay valid
+        if ((std::size_t)id >= routes_.size()) routes_.resize((int)id + 1);
+        routes_[(int)id] = std::move(src.routes_[(int)id]);
+        if (src.slot_ == routed) src.slot_ = &src.own_;
+      } else {
+        slot = &own_;
+        own_.active_handle = std::exchange(src.own_.active_handle, {});
+        own_.txn_stack.swap(src.own_.txn_stack);
+        own_.result = std::exchange(src.own_.result, result_t{});
+        own_.out = std::move(src.own_.out);
+        src.own_.out = std::monostate{};
+      }
+      auto rebind = [this, slot](handle_type h) {
+        auto& promise = h.promise();
+        promise.set_context(*this);
+        if (promise.txn_slot()) promise.set_txn_slot(slot);
+      };
+      for (auto h : slot->txn_stack) rebind(h);
+      rebind(slot->active_handle);
+      return {};
+    }
 
     template<typename Var>
     auto msg_name(const Var& arg) {
-      return std::visit(msg_name_fn_, arg);
+      if constexpr (std::is_same_v<MsgNameFnT,
+                        decltype(detail::default_msg_name_fn)>) {
+        return msg::name(arg);  // a table lookup; no visit
+      } else {
+        return msg::visit(msg_name_fn_, arg);
+      }
     }
 
+    // A txn tree's share of the context's state.
+    struct slot_t {
+      handle_type active_handle{};
+      std::vector<handle_type> txn_stack;
+      result_t result{result_code::s_ok};
+      out_msg_type out;
+    };
+
   private:
-    handle_type active_handle_{};
-    result_t result_{result_code::s_ok};
+    static bool has_deadline(const slot_t& slot) {
+      for (auto h : slot.txn_stack) {
+        if (h.promise().deadline_armed()) return true;
+      }
+      return slot.active_handle.promise().deadline_armed();
+    }
+
+    slot_t* find_txn(id_t id) const {
+      const auto idx = (std::size_t)id;
+      return idx < routes_.size() ? routes_[idx].get() : nullptr;
+    }
+
+    slot_t own_;
+    slot_t* slot_{&own_};  // the current txn tree's
+    std::vector<std::unique_ptr<slot_t>> routes_;  // by root txn id
+    result_t route_result_;
     in_msg_type in_;
-    out_msg_type out_;
     MsgNameFnT& msg_name_fn_;
+    memory::frame_arena_t* frame_arena_{};
+    timer::wheel_t* deadline_wheel_{};
+    [[no_unique_address]] stats::txn_registry_t txn_stats_;
   };  // txn::context_t
 
+  // Advance wheel, shared by contexts of type ContextT, to time, and abort
+  // each txn whose deadline has passed. An aborted txn that is its
+  // context's active txn, and is not suspended on an event, is resumed
+  // at once; it completes with result_code::e_abort, and on_out(context,
+  // context.out()) is called. Any other aborted txn completes when it
+  // next resumes: when the nested txn it awaits completes, or when its
+  // event fires. Returns the number of txns aborted.
+  template <Context ContextT, typename OutFn>
+  std::size_t expire_deadlines(timer::wheel_t& wheel,
+      timer::clock_type::time_point time, OutFn&& on_out) {
+    using promise_type = ContextT::promise_type;
+    using handle_type = ContextT::handle_type;
+    return wheel.advance(time, [&on_out](timer::node_t& node) {
+      auto& promise = *static_cast<promise_type*>(node.owner);
+      auto& context = promise.context();
+      context.bind_txn(promise);
+      log::info("task_id:{} deadline expired", promise.txn_id());
+      promise.abort_txn();
+      auto handle = handle_type::from_promise(promise);
+      if ((handle == context.active_handle())
+          && !promise.suspended_on_event()) {
+        handle.resume();
+        on_out(context, std::as_const(context.out()));
+      }
+    });
+  }
+
   // txn::receive_awaitable
   template <typename TaskT> //, typename MsgT, typename StateT>
   struct receive_awaitable
@@ -284,11 +658,11 @@ namespace cope::txn {
       ensure_not_running();
       if (this->promise().txn_status() == status::complete) {
         this->promise().set_txn_status(status::ready);
-        if (this->promise().prev_handle().has_value()) {
-          // txn complete + prev handle exists; symmetric xfer to prev_handle
-          return activate_prev_handle();
+        if (this->context().txn_depth()) {
+          // nested txn complete; symmetric xfer to the awaiting txn
+          return activate_parent();
         } else {
-          // txn complete + no prev handle; resume in send_msg()
+          // outermost txn complete; resume in send_msg()
           this->context().out() = std::monostate{};
         }
       }
@@ -299,44 +673,47 @@ namespace cope::txn {
     promise_type& await_resume() {
       log::info("task_id:{} receive_awaitable::await_resume()",
         this->promise().txn_id());
-      auto& txn = this->context().in();
-      /* TODO: start_txn validation
-      // validate this is a start_txn message for the expected txn_id
-      if (this->context().set_result(start_t::validate(txn, txn_id_)
-        .failed()) {
-        log::info("task_id:{} ERROR resuming: {}", this->promise().txn_id(),
-          this->context().result().code);
-        return this->promise(); // TODO: error handling
+      auto txn_start =
+          msg::detail::get_exact_if<start_txn_t>(this->context().in());
+      if (!txn_start) {
+        // the txn starts and completes at once, with the failure
+        log::info("task_id:{} ERROR resuming: not a start_txn",
+            this->promise().txn_id());
+        this->context().set_result(result_code::e_unexpected_msg_type);
+        this->promise().set_txn_status(status::running);
+        return this->promise();
       }
-      */
-      auto& txn_start = std::get<start_txn_t>(txn);
+      // a txn's result is reported to the caller of that txn only, so
+      // that a failure, even an unexpected one, doesn't stop the next
+      this->context().set_result(result_code::s_ok);
       // move initial state into coroutine frame
-      state_ = std::move(txn_start.state);
+      state_ = std::move(txn_start->state);
       // move msg from incoming txn to context.in
       // this is a little awkward
-      auto msg{std::move(txn_start.msg)};
+      auto msg{std::move(txn_start->msg)};
       this->context().in() = std::move(msg);
       this->promise().set_txn_status(status::running);
       return this->promise();
     }
 
   private:
-    auto activate_prev_handle() {
-      auto prev_handle = this->promise().prev_handle().value();
+    auto activate_parent() {
+      auto parent = this->context().pop_active_handle();
       log::info("  symmetric xfer to previous task_id:{}",
-          prev_handle.promise().txn_id());
-      this->context().set_active_handle(prev_handle);
-      this->promise().prev_handle().reset();
-      return prev_handle;
+          parent.promise().txn_id());
+      return parent;
     }
 
+    // A txn that is still running completes here with
+    // result_code::e_unexpected.
     void ensure_not_running() {
       if (this->promise().txn_running()) {
-        log::info("task is running");
-        throw std::runtime_error(
+        this->context().set_result(cope::detail::fail(
+            result_code::e_unexpected,
             std::format("task_id:{} receive_awaitable::await_suspend(), "
                         "task cannot be running",
-                this->promise().txn_id()));
+                this->promise().txn_id())));
+        this->promise().set_txn_status(status::complete);
       }
     }
 
@@ -365,22 +742,23 @@ namespace cope::txn {
     auto await_suspend(handle_type h) {
       base_type::await_suspend(h);
       log::info("task_id:{} suspending...", this->promise().txn_id());
+      this->promise().probe().await_begin();
       // symmetric transfer to handle
       return start(dst_handle_, {std::move(msg_), std::move(state_)});
     }
 
     auto& await_resume() {
       log::info("task_id:{} resuming...", this->promise().txn_id());
+      this->promise().probe().await_end();
       return this->promise();
     }
 
   private:
     auto start(handle_type handle, start_txn_t&& txn_start) {
-      auto& promise = handle.promise();
-      promise.context().in() = std::move(txn_start);
-      log::info("  symmetric xfer to task_id:{}", promise.txn_id());
-      promise.set_prev_handle(this->context().active_handle());
-      this->context().set_active_handle(handle);
+      auto& context = this->context();
+      context.in() = std::move(txn_start);
+      log::info("  symmetric xfer to task_id:{}", handle.promise().txn_id());
+      context.push_active_handle(handle);
       return handle;
     }
 
@@ -388,6 +766,79 @@ namespace cope::txn {
     msg_type msg_;
     state_type state_;
   };  // txn::start_awaitable
+
+  // txn::variant_awaitable
+  //
+  // One of several awaitables, for a manager that can start any of
+  // several kinds of nested txn. It is constructed empty, which costs
+  // nothing, and the manager assigns or emplaces the one it wants in
+  // get_awaiter(), which constructs it in place. Each await_*() call
+  // dispatches to the active alternative through an unrolled index
+  // comparison rather than std::visit's table of function pointers, so
+  // every alternative's await_*() is inlined as it would be if it were
+  // awaited directly. An empty one must not be awaited.
+  template <typename... AwaitableTs>
+  struct variant_awaitable : std::variant<std::monostate, AwaitableTs...> {
+    using base_type = std::variant<std::monostate, AwaitableTs...>;
+    using base_type::base_type;
+    using base_type::operator=;
+
+    bool empty() const { return !this->index(); }
+
+    bool await_ready() {
+      return dispatch([](auto& awaitable) -> bool {
+        return awaitable.await_ready();
+      });
+    }
+
+    template <typename PromiseT>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<PromiseT> h) {
+      return dispatch([h](auto& awaitable) -> std::coroutine_handle<> {
+        using result_type = decltype(awaitable.await_suspend(h));
+        if constexpr (std::is_void_v<result_type>) {
+          awaitable.await_suspend(h);
+          return std::noop_coroutine();
+        } else if constexpr (std::is_same_v<result_type, bool>) {
+          if (awaitable.await_suspend(h)) return std::noop_coroutine();
+          return h;
+        } else {
+          return awaitable.await_suspend(h);
+        }
+      });
+    }
+
+    void await_resume() {
+      dispatch([](auto& awaitable) { awaitable.await_resume(); });
+    }
+
+  private:
+    template <typename FnT>
+    decltype(auto) dispatch(FnT&& fn) {
+      return dispatch(std::forward<FnT>(fn),
+          std::make_index_sequence<sizeof...(AwaitableTs) - 1>{});
+    }
+
+    // compares the index against all but the last awaitable, which is
+    // taken when none match; index 0 is the empty state
+    template <typename FnT, std::size_t... Is>
+    decltype(auto) dispatch(FnT&& fn, std::index_sequence<Is...>) {
+      using result_type = decltype(fn(*std::get_if<1>(this)));
+      constexpr auto kLast = sizeof...(Is) + 1;
+      const auto index = this->index();
+      if constexpr (std::is_void_v<result_type>) {
+        ((index == Is + 1 ? (fn(*std::get_if<Is + 1>(this)), true) : false)
+            || ...)
+            || (fn(*std::get_if<kLast>(this)), true);
+      } else {
+        result_type result;
+        ((index == Is + 1 ? (result = fn(*std::get_if<Is + 1>(this)), true)
+                          : false)
+            || ...)
+            || (result = fn(*std::get_if<kLast>(this)), true);
+        return result;
+      }
+    }
+  };  // txn::variant_awaitable
 } // namespace cope::txn
 
 // clang-format off
@@ -0,0 +1,440 @@
+// cope_wire.h
+
+#pragma once
+
+#ifndef INCLUDE_COPE_WIRE_H
+#define INCLUDE_COPE_WIRE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "cope_intern.h"
+#include "cope_msg.h"
+#include "cope_msg_registry.h"
+
+// Binary encoding of bundle messages, for sending them between processes
+// and storing them on disk.
+//
+// A message is encoded as a frame:
+//
+//   u32 tag    the message type's msg::registry_t id
+//   u32 size   payload size in bytes
+//   payload    encoded by codec_t<T>, zero-padded to a multiple of kAlign
+//
+// Frames start at kAlign-aligned offsets, so a trivially copyable
+// message whose alignment is at most kAlign can be read in place through
+// view() rather than decoded. Integers are stored in host byte order.
+//
+// Trivially copyable types, strings, intern::symbol_ts, vectors, optionals
+// and start_txn_ts have codecs here. Specialize codec_t for other message and state types;
+// fields_codec_t does this for a list of data members.
+namespace cope::wire {
+  inline constexpr std::size_t kAlign{8};
+
+  // wire::writer_t
+  //
+  // Appends encoded bytes to a growable buffer.
+  class writer_t {
+  public:
+    void write(const void* data, std::size_t size) {
+      auto bytes = static_cast<const std::byte*>(data);
+      buffer_.insert(buffer_.end(), bytes, bytes + size);
+    }
+
+    template <typename T>
+    requires std::is_trivially_copyable_v<T>
+    void put(const T& value) { write(&value, sizeof(T)); }
+
+    // Reserves a T to be filled in later with patch(); returns its offset.
+    template <typename T>
+    std::size_t reserve() {
+      auto offset = buffer_.size();
+      buffer_.resize(offset + sizeof(T));
+      return offset;
+    }
+
+    template <typename T>
+    void patch(std::size_t offset, const T& value) {
+      std::memcpy(buffer_.data() + offset, &value, sizeof(T));
+    }
+
+    // zero-pads to a multiple of kAlign bytes
+    void align() {
+      buffer_.resize((buffer_.size() + kAlign - 1) & ~(kAlign - 1));
+    }
+
+    const std::byte* data() const { return buffer_.data(); }
+    std::size_t size() const { return buffer_.size(); }
+    std::span<const std::byte> bytes() const { return buffer_; }
+
+    // keeps the buffer's capacity
+    void clear() { buffer_.clear(); }
+
+  private:
+    std::vector<std::byte> buffer_;
+  };  // wire::writer_t
+
+  // wire::reader_t
+  //
+  // Bounds-checked reads from a span of bytes.
+  class reader_t {
+  public:
+    reader_t(const std::byte* begin, const std::byte* end)
+        : pos_(begin), end_(end) {}
+    explicit reader_t(std::span<const std::byte> bytes)
+        : reader_t(bytes.data(), bytes.data() + bytes.size()) {}
+
+    void read(void* data, std::size_t size) {
+      std::memcpy(data, take(size), size);
+    }
+
+    template <typename T>
+    requires std::is_trivially_copyable_v<T>
+    T get() {
+      T value;
+      read(&value, sizeof(T));
+      return value;
+    }
+
+    const std::byte* take(std::size_t size) {
+      if ((std::size_t)(end_ - pos_) < size) {
+        throw std::runtime_error("wire: truncated");
+      }
+      auto data = pos_;
+      pos_ += size;
+      return data;
+    }
+
+    bool empty() const { return pos_ == end_; }
+    const std::byte* pos() const { return pos_; }
+    std::size_t remaining() const { return (std::size_t)(end_ - pos_); }
+
+  private:
+    const std::byte* pos_;
+    const std::byte* end_;
+  };  // wire::reader_t
+
+  // Encodes a T to a writer_t and decodes it from a reader_t. decode()
+  // assigns into an existing T so that strings and vectors reuse their
+  // capacity.
+  template <typename T>
+  struct codec_t;
+
+  template <typename T>
+  requires std::is_trivially_copyable_v<T>
+  struct codec_t<T> {
+    static constexpr bool kRaw{true};
+
+    static void encode(writer_t& out, const T& value) { out.put(value); }
+    static void decode(reader_t& in, T& value) { in.read(&value, sizeof(T)); }
+  };
+
+  // True if a T is encoded as its bytes, so that an array of them can be
+  // copied whole and one can be read in place. False for a trivially
+  // copyable type with a codec_t specialization of its own.
+  template <typename T>
+  inline constexpr bool is_raw_v = requires { codec_t<T>::kRaw; };
+
+  template <>
+  struct codec_t<std::string> {
+    static void encode(writer_t& out, const std::string& str) {
+      out.put((std::uint32_t)str.size());
+      out.write(str.data(), str.size());
+    }
+    static void decode(reader_t& in, std::string& str) {
+      auto size = in.get<std::uint32_t>();
+      str.assign(reinterpret_cast<const char*>(in.take(size)), size);
+    }
+  };
+
+  // as its string, since symbol ids are local to a process
+  template <>
+  struct codec_t<intern::symbol_t> {
+    static void encode(writer_t& out, intern::symbol_t sym) {
+      const auto str = intern::str(sym);
+      out.put((std::uint32_t)str.size());
+      out.write(str.data(), str.size());
+    }
+    static void decode(reader_t& in, intern::symbol_t& sym) {
+      auto size = in.get<std::uint32_t>();
+      sym = intern::intern_recent(
+          {reinterpret_cast<const char*>(in.take(size)), size});
+    }
+  };
+
+  template <typename T>
+  requires (!std::is_trivially_copyable_v<std::vector<T>>)
+  struct codec_t<std::vector<T>> {
+    static void encode(writer_t& out, const std::vector<T>& vec) {
+      out.put((std::uint32_t)vec.size());
+      if constexpr (is_raw_v<T>) {
+        out.write(vec.data(), vec.size() * sizeof(T));
+      } else {
+        for (const auto& elem : vec) codec_t<T>::encode(out, elem);
+      }
+    }
+    // The count is checked against the bytes left before the vector is
+    // sized, so a corrupt one can't make it allocate: a raw element takes
+    // sizeof(T) bytes, and any other at least one.
+    static void decode(reader_t& in, std::vector<T>& vec) {
+      const auto count = in.get<std::uint32_t>();
+      constexpr std::size_t min_size{is_raw_v<T> ? sizeof(T) : 1};
+      if (count > in.remaining() / min_size) {
+        throw std::runtime_error("wire: truncated");
+      }
+      vec.resize(count);
+      if constexpr (is_raw_v<T>) {
+        in.read(vec.data(), vec.size() * sizeof(T));
+      } else {
+        for (auto& elem : vec) codec_t<T>::decode(in, elem);
+      }
+    }
+  };
+
+  template <typename T>
+  requires (!std::is_trivially_copyable_v<std::optional<T>>)
+  struct codec_t<std::optional<T>> {
+    static void encode(writer_t& out, const std::optional<T>& opt) {
+      out.put(opt.has_value());
+      if (opt) codec_t<T>::encode(out, *opt);
+    }
+    static void decode(reader_t& in, std::optional<T>& opt) {
+      if (!in.get<bool>()) {
+        opt.reset();
+        return;
+      }
+      if (!opt) opt.emplace();
+      codec_t<T>::decode(in, *opt);
+    }
+  };
+
+  // Encodes the listed data members of a type, in order:
+  //
+  //   template <> struct cope::wire::codec_t<my::msg::data_t>
+  //       : cope::wire::fields_codec_t<&my::msg::data_t::name,
+  //             &my::msg::data_t::values> {};
+  template <auto... Members>
+  struct fields_codec_t {
+    template <typename T>
+    static void encode(writer_t& out, const T& value) {
+      (field_codec<T, Members>::encode(out, value.*Members), ...);
+    }
+    template <typename T>
+    static void decode(reader_t& in, T& value) {
+      (field_codec<T, Members>::decode(in, value.*Members), ...);
+    }
+
+  private:
+    template <typename T, auto Member>
+    using field_codec =
+        codec_t<std::remove_cvref_t<decltype(std::declval<T&>().*Member)>>;
+  };
+
+  template <typename MsgT, typename StateT>
+  requires (!std::is_trivially_copyable_v<msg::start_txn_t<MsgT, StateT>>)
+  struct codec_t<msg::start_txn_t<MsgT, StateT>>
+      : fields_codec_t<&msg::start_txn_t<MsgT, StateT>::msg,
+            &msg::start_txn_t<MsgT, StateT>::state> {};
+
+  // The frame tag of message type T, its msg::id_of. It is written to
+  // files and shared memory, so it must be the same in every build.
+  template <typename T>
+  constexpr std::uint32_t tag_of() {
+    static_assert(msg::stable_id_v<T>, "a message type encoded by "
+        "cope::wire must declare a msg::info_t<T>::name or id");
+    return (std::uint32_t)msg::id_of<T>;
+  }
+
+  struct header_t {
+    std::uint32_t tag;
+    std::uint32_t size;
+  };
+  static_assert(sizeof(header_t) == kAlign);
+
+  // A decoded frame header and its payload, which points into the
+  // encoded bytes.
+  struct frame_t {
+    std::uint32_t tag;
+    std::span<const std::byte> payload;
+
+    msg::id_type id() const { return (msg::id_type)tag; }
+
+    template <typename T>
+    bool holds() const { return tag == tag_of<T>(); }
+
+    reader_t reader() const { return reader_t{payload}; }
+  };
+
+  // Encode msg as a frame with the given tag; see encode().
+  template <typename T>
+  void encode_as(writer_t& out, std::uint32_t tag, const T& msg) {
+    out.align();
+    auto header_offset = out.reserve<header_t>();
+    codec_t<T>::encode(out, msg);
+    out.patch(header_offset, header_t{tag, (std::uint32_t)(
+        out.size() - header_offset - sizeof(header_t))});
+    out.align();
+  }
+
+  // Encode msg, a message type or a message variant, as a frame. A proxy
+  // is encoded as the message it refers to, which decodes by value.
+  template <typename T>
+  void encode(writer_t& out, const T& msg) {
+    if constexpr (requires { typename msg::registry_for_t<T>; }) {
+      msg::visit([&out](const auto& m) { encode(out, m); }, msg);
+    } else if constexpr (proxy::is_proxy_v<T>) {
+      encode(out, msg.get());
+    } else {
+      encode_as(out, tag_of<T>(), msg);
+    }
+  }
+
+  // Read the next frame from in, or nullopt at the end of input.
+  inline std::optional<frame_t> next(reader_t& in) {
+    if (in.empty()) return std::nullopt;
+    auto header = in.get<header_t>();
+    frame_t frame{header.tag, {in.take(header.size), header.size}};
+    const auto padding = (kAlign - header.size % kAlign) % kAlign;
+    if (!in.empty()) in.take(padding);
+    return frame;
+  }
+
+  // A pointer to frame's payload as a T, without copying, or nullptr if
+  // frame holds some other message. The payload must be kAlign-aligned,
+  // which it is when the encoded bytes start at a kAlign boundary.
+  template <typename T>
+  requires is_raw_v<T> && (alignof(T) <= kAlign)
+  const T* view(const frame_t& frame) {
+    if (!frame.holds<T>() || (frame.payload.size() != sizeof(T))) {
+      return nullptr;
+    }
+    if ((std::uintptr_t)frame.payload.data() % alignof(T)) {
+      throw std::runtime_error("wire: misaligned payload");
+    }
+    return std::launder(reinterpret_cast<const T*>(frame.payload.data()));
+  }
+
+  namespace detail {
+    [[noreturn]] inline void throw_proxy_frame() {
+      throw std::runtime_error("wire: proxy message frame");
+    }
+
+    template <typename T, typename VariantT>
+    void decode_into(reader_t& in, VariantT& var) {
+      if constexpr (proxy::is_proxy_v<T>) {
+        throw_proxy_frame();  // never encoded; see encode()
+      } else {
+        auto msg = msg::detail::get_exact_if<T>(var);
+        if (!msg) msg = &var.template emplace<T>();
+        codec_t<T>::decode(in, *msg);
+      }
+    }
+
+    // whether the frame tags of the messages in TupleT are stable; a
+    // proxy is never encoded
+    template <typename TupleT>
+    inline constexpr bool stable_tags_v = false;
+
+    template <typename... Ts>
+    inline constexpr bool stable_tags_v<std::tuple<Ts...>> =
+        ((msg::stable_id_v<Ts> || proxy::is_proxy_v<Ts>) && ...);
+
+    template <typename VariantT, typename... Ts>
+    void decode(std::size_t index, reader_t& in, VariantT& var,
+        std::tuple<Ts...>*) {
+      static_assert(stable_tags_v<std::tuple<Ts...>>, "a message type "
+          "decoded by cope::wire must declare a msg::info_t<T>::name or id");
+      using fn_type = void (*)(reader_t&, VariantT&);
+      static constexpr fn_type table[]{&decode_into<Ts, VariantT>...};
+      table[index](in, var);
+    }
+  }  // namespace detail
+
+  // Decode frame into var, a message variant. If var already holds the
+  // frame's message type, its value is decoded into in place.
+  template <typename VariantT>
+  void decode(const frame_t& frame, VariantT& var) {
+    using registry = msg::registry_for_t<VariantT>;
+    auto index = registry::find(frame.id());
+    if (!index.has_value()) {
+      throw std::runtime_error(
+          "wire: message id " + std::to_string(frame.id()) + " not in bundle");
+    }
+    auto in = frame.reader();
+    detail::decode(*index, in, var, (typename registry::tuple_type*)nullptr);
+  }
+
+  // wire::sender_t
+  //
+  // Decodes frames and sends them to a task. Each message is decoded into
+  // a scratch slot of its type that is reused from one message to the
+  // next, and after each send the context's in message is swapped back
+  // into the slot, so that strings and vectors reuse their capacity rather
+  // than allocating per message.
+  template <typename ContextT>
+  class sender_t {
+  public:
+    using in_msg_type = ContextT::in_msg_type;
+    using out_msg_type = ContextT::out_msg_type;
+    using in_registry_type = msg::registry_for_t<in_msg_type>;
+    static_assert(
+        detail::stable_tags_v<typename in_registry_type::tuple_type>,
+        "a message type decoded by cope::wire must declare a "
+        "msg::info_t<T>::name or id");
+
+    // task.send_msg() of the message in frame
+    template <typename TaskT>
+    const out_msg_type& send(TaskT& task, const frame_t& frame) {
+      auto index = in_registry_type::find(frame.id());
+      if (!index.has_value()) {
+        throw std::runtime_error("wire: message id "
+                                 + std::to_string(frame.id())
+                                 + " not in bundle");
+      }
+      auto payload = frame.reader();
+      return send(task, *index, payload,
+          std::make_index_sequence<in_registry_type::size>{});
+    }
+
+  private:
+    template <typename TaskT, std::size_t... Is>
+    const out_msg_type& send(TaskT& task, std::size_t index,
+        reader_t& payload, std::index_sequence<Is...>) {
+      using fn_type = const out_msg_type& (*)(sender_t&, TaskT&, reader_t&);
+      static constexpr fn_type table[]{&send_one<Is, TaskT>...};
+      return table[index](*this, task, payload);
+    }
+
+    template <std::size_t I, typename TaskT>
+    static const out_msg_type& send_one(sender_t& self, TaskT& task,
+        reader_t& payload) {
+      using T = std::tuple_element_t<I,
+          typename in_registry_type::tuple_type>;
+      if constexpr (proxy::is_proxy_v<T>) {
+        detail::throw_proxy_frame();
+      } else {
+        auto& scratch = std::get<I>(self.scratch_);
+        codec_t<T>::decode(payload, scratch);
+        const auto& out = task.send_msg(std::move(scratch));
+        // reclaim the buffers of the msg the context was left holding
+        if (auto held = msg::detail::get_exact_if<T>(task.context().in())) {
+          std::swap(*held, scratch);
+        }
+        return out;
+      }
+    }
+
+    typename in_registry_type::tuple_type scratch_{};
+  };  // wire::sender_t
+}  // namespace cope::wire
+
+#endif  // INCLUDE_COPE_WIRE_H
@@ -8,33 +8,108 @@
 #include <iostream>
 #include <format>
 #include <functional>
+#include <mutex>
 #include <string>
+#include <type_traits>
 #include <utility>
+#include "cope_log_async.h"
+
+// Compile-time log level. Calls below COPE_LOG_LEVEL compile to nothing.
+// Release builds default to errors only, so the info logging on the
+// send_msg/yield hot path costs nothing unless explicitly compiled in.
+#define COPE_LOG_LEVEL_INFO 0
+#define COPE_LOG_LEVEL_ERROR 1
+#define COPE_LOG_LEVEL_NONE 2
+
+#ifndef COPE_LOG_LEVEL
+#ifdef NDEBUG
+#define COPE_LOG_LEVEL COPE_LOG_LEVEL_ERROR
+#else
+#define COPE_LOG_LEVEL COPE_LOG_LEVEL_INFO
+#endif
+#endif
 
 namespace cope::log {
   using fn_t = std::function<void(const std::string& msg)>;
 
+  enum class level : int {
+    info = COPE_LOG_LEVEL_INFO,
+    error = COPE_LOG_LEVEL_ERROR,
+    none = COPE_LOG_LEVEL_NONE
+  };
+
+  inline constexpr auto kLevel{static_cast<level>(COPE_LOG_LEVEL)};
+
+  inline constexpr bool compiled(level lvl) { return lvl >= kLevel; }
+
   inline bool enabled = false;
   inline void enable(bool enable = true) { enabled = enable; }
 
+  // synchronous output; see cope_log_async.h for the asynchronous backend
   inline fn_t func = [](const std::string& msg) { std::cout << msg << std::endl; };
-  inline void set_logger(auto& func) { func = func; }
+  inline void set_logger(fn_t fn) { func = std::move(fn); }
+
+  namespace detail {
+    // Calls to func are serialized, so that threads, e.g. engine workers,
+    // may log synchronously through a func that isn't thread-safe.
+    inline std::mutex func_mutex;
+
+    inline void write(const std::string& msg) {
+      std::lock_guard lock{func_mutex};
+      func(msg);
+    }
+  }  // namespace detail
+
+  // A log argument that is only evaluated if the message is formatted,
+  // e.g. log::info("{}", log::lazy([&] { return expensive(); }));
+  template <typename FnT>
+  struct lazy_t {
+    using value_type = std::decay_t<std::invoke_result_t<const FnT&>>;
+
+    decltype(auto) operator()() const { return fn(); }
+
+    FnT fn;
+  };
+
+  template <typename FnT>
+  inline auto lazy(FnT fn) { return lazy_t<FnT>{std::move(fn)}; }
 
   template<typename... Args>
-  void info(const char* fmt, Args&&... args) {
-    if (enabled) {
-      func(std::vformat(fmt, std::make_format_args(std::forward<Args>(args)...)));
+  void info(std::format_string<Args...> fmt, Args&&... args) {
+    if constexpr (compiled(level::info)) {
+      if (enabled) {
+        if (async::running()) {
+          async::push(false, fmt.get(), args...);
+        } else {
+          detail::write(std::format(fmt, std::forward<Args>(args)...));
+        }
+      }
     }
   };
 
   template<typename... Args>
-  void error(const char* fmt, Args&&... args) {
-    if (enabled) {
-      func(std::vformat(std::format("ERROR: {}", fmt),
-          std::make_format_args(std::forward<Args>(args)...)));
+  void error(std::format_string<Args...> fmt, Args&&... args) {
+    if constexpr (compiled(level::error)) {
+      if (enabled) {
+        if (async::running()) {
+          async::push(true, fmt.get(), args...);
+        } else {
+          detail::write(
+              "ERROR: " + std::format(fmt, std::forward<Args>(args)...));
+        }
+      }
     }
   };
 
 } // namespace cope::log
 
+template <typename FnT>
+struct std::formatter<cope::log::lazy_t<FnT>>
+    : std::formatter<typename cope::log::lazy_t<FnT>::value_type> {
+  auto format(const cope::log::lazy_t<FnT>& arg, format_context& ctx) const {
+    using value_type = cope::log::lazy_t<FnT>::value_type;
+    return std::formatter<value_type>::format(arg(), ctx);
+  }
+};
+
 #endif // INCLUDE_COPE_LOG_H
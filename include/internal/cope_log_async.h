@@ -0,0 +1,314 @@
+// cope_log_async.h
+
+#pragma once
+
+#ifndef INCLUDE_COPE_LOG_ASYNC_H
+#define INCLUDE_COPE_LOG_ASYNC_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace cope::log {
+  template <typename FnT>
+  struct lazy_t;
+}
+
+// Asynchronous logging backend.
+//
+// While running, log::info/error copy their arguments in binary form into
+// a per-thread single-producer/single-consumer ring, and a background
+// thread formats and writes them in batches. Producers never lock or
+// block: when a ring is full the record is dropped and counted.
+//
+// Arguments are captured by value: strings are copied inline (truncated
+// to kStringArgSize), trivially copyable values are copied as-is, lazy
+// arguments are evaluated on the calling thread, and anything else is
+// formatted on the calling thread.
+namespace cope::log::async {
+  inline constexpr std::size_t kRecordSize{256};
+  inline constexpr std::size_t kStringArgSize{48};
+
+  using sink_fn_t = std::function<void(std::string_view batch)>;
+
+  struct options_t {
+    // records per thread ring; rounded up to a power of 2
+    std::size_t ring_capacity{1024};
+    std::chrono::microseconds poll_interval{1000};
+    sink_fn_t sink{[](std::string_view batch) {
+      std::cout.write(batch.data(), (std::streamsize)batch.size());
+      std::cout.flush();
+    }};
+  };
+
+  template <std::size_t N>
+  struct inline_string_t {
+    inline_string_t() = default;
+    explicit inline_string_t(std::string_view str)
+        : size((std::uint16_t)std::min(str.size(), N)) {
+      std::memcpy(data, str.data(), size);
+    }
+
+    std::string_view view() const { return {data, size}; }
+
+    std::uint16_t size{};
+    char data[N];
+  };
+
+  namespace detail {
+    struct record_t;
+    using format_fn_t = void (*)(const record_t& record, std::string& out);
+
+    struct alignas(64) record_t {
+      static constexpr std::size_t kHeaderSize{64};
+      static constexpr std::size_t kArgsSize{kRecordSize - kHeaderSize};
+
+      format_fn_t format;
+      std::string_view fmt;
+      bool error;
+      alignas(kHeaderSize) std::byte args[kArgsSize];
+    };
+    static_assert(sizeof(record_t) == kRecordSize);
+
+    template <typename T>
+    struct is_lazy : std::false_type {};
+
+    template <typename FnT>
+    struct is_lazy<lazy_t<FnT>> : std::true_type {};
+
+    template <typename T>
+    auto store(const T& arg) {
+      if constexpr (is_lazy<T>::value) {
+        return store(arg());
+      } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+        return inline_string_t<kStringArgSize>{std::string_view{arg}};
+      } else if constexpr (std::is_trivially_copyable_v<T>) {
+        return arg;
+      } else {
+        return inline_string_t<kStringArgSize>{std::format("{}", arg)};
+      }
+    }
+
+    template <typename TupleT>
+    void format_args(const record_t& record, std::string& out) {
+      const auto& args =
+          *std::launder(reinterpret_cast<const TupleT*>(record.args));
+      std::apply([&](const auto&... arg) {
+        out += std::vformat(record.fmt, std::make_format_args(arg...));
+      }, args);
+    }
+
+    // single-producer/single-consumer ring of records
+    class ring_t {
+    public:
+      explicit ring_t(std::size_t capacity)
+          : capacity_(std::bit_ceil(std::max<std::size_t>(capacity, 2))),
+            records_(new record_t[capacity_]) {}
+
+      // producer
+      record_t* try_claim() {
+        if (head_ - tail_cache_ >= capacity_) {
+          tail_cache_ = tail_.load(std::memory_order_acquire);
+          if (head_ - tail_cache_ >= capacity_) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+          }
+        }
+        return &records_[head_ & (capacity_ - 1)];
+      }
+
+      void publish() {
+        published_.store(++head_, std::memory_order_release);
+      }
+
+      // consumer
+      template <typename FnT>
+      std::size_t drain(FnT&& fn) {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        auto head = published_.load(std::memory_order_acquire);
+        for (auto pos = tail; pos != head; ++pos) {
+          fn(records_[pos & (capacity_ - 1)]);
+        }
+        tail_.store(head, std::memory_order_release);
+        return head - tail;
+      }
+
+      bool empty() const {
+        return tail_.load(std::memory_order_acquire)
+               == published_.load(std::memory_order_acquire);
+      }
+
+      auto dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    private:
+      const std::size_t capacity_;
+      std::unique_ptr<record_t[]> records_;
+      // producer-local
+      alignas(64) std::size_t head_{};
+      std::size_t tail_cache_{};
+      alignas(64) std::atomic<std::size_t> published_{};
+      alignas(64) std::atomic<std::size_t> tail_{};
+      std::atomic<std::uint64_t> dropped_{};
+    };  // ring_t
+
+    // Rings are shared between their producer thread and the registry, so
+    // records logged just before a thread exits are still written.
+    struct registry_t {
+      std::shared_ptr<ring_t> add() {
+        std::lock_guard lock{mutex};
+        return rings.emplace_back(std::make_shared<ring_t>(ring_capacity));
+      }
+
+      std::mutex mutex;
+      std::vector<std::shared_ptr<ring_t>> rings;
+      std::uint64_t retired_dropped{};
+      std::size_t ring_capacity{options_t{}.ring_capacity};
+    };
+
+    inline registry_t& registry() {
+      static registry_t registry;
+      return registry;
+    }
+
+    inline ring_t& thread_ring() {
+      thread_local std::shared_ptr<ring_t> ring = registry().add();
+      return *ring;
+    }
+
+    class backend_t {
+    public:
+      explicit backend_t(options_t options) : options_(std::move(options)) {
+        {
+          std::lock_guard lock{registry().mutex};
+          registry().ring_capacity = options_.ring_capacity;
+        }
+        thread_ = std::jthread([this](std::stop_token stop) { run(stop); });
+      }
+
+    private:
+      void run(std::stop_token stop) {
+        std::string batch;
+        while (true) {
+          const bool stopping = stop.stop_requested();
+          batch.clear();
+          auto count = drain(batch);
+          if (count) options_.sink(batch);
+          if (!count) {
+            if (stopping) break;
+            std::this_thread::sleep_for(options_.poll_interval);
+          }
+        }
+      }
+
+      std::size_t drain(std::string& batch) {
+        auto& reg = registry();
+        std::lock_guard lock{reg.mutex};
+        std::size_t count{};
+        for (auto& ring : reg.rings) {
+          count += ring->drain([&batch](const record_t& record) {
+            if (record.error) batch += "ERROR: ";
+            record.format(record, batch);
+            batch += '\n';
+          });
+        }
+        // retire rings whose producer thread has exited
+        std::erase_if(reg.rings, [&reg](const auto& ring) {
+          if (ring.use_count() > 1 || !ring->empty()) return false;
+          reg.retired_dropped += ring->dropped();
+          return true;
+        });
+        return count;
+      }
+
+      options_t options_;
+      std::jthread thread_;
+    };  // backend_t
+
+    inline std::atomic<bool> is_running{false};
+    inline std::unique_ptr<backend_t> backend;
+  }  // namespace detail
+
+  inline bool running() {
+    return detail::is_running.load(std::memory_order_relaxed);
+  }
+
+  // Start the background writer. Not thread-safe with respect to stop().
+  inline void start(options_t options = {}) {
+    if (detail::backend) return;
+    detail::backend = std::make_unique<detail::backend_t>(std::move(options));
+    detail::is_running.store(true, std::memory_order_release);
+  }
+
+  // Stop logging asynchronously, and write every record already queued.
+  // Records pushed by threads that observed running() before the stop
+  // may remain queued until the next start().
+  inline void stop() {
+    detail::is_running.store(false, std::memory_order_release);
+    detail::backend.reset();
+  }
+
+  // total records dropped because a ring was full
+  inline std::uint64_t dropped() {
+    auto& reg = detail::registry();
+    std::lock_guard lock{reg.mutex};
+    auto total = reg.retired_dropped;
+    for (const auto& ring : reg.rings) total += ring->dropped();
+    return total;
+  }
+
+  template <typename... Args>
+  void push(bool error, std::string_view fmt, const Args&... args) {
+    using namespace detail;
+    auto& ring = thread_ring();
+    auto record = ring.try_claim();
+    if (!record) return;
+    using tuple_type = std::tuple<decltype(store(args))...>;
+    if constexpr (sizeof(tuple_type) <= record_t::kArgsSize
+                  && alignof(tuple_type) <= record_t::kHeaderSize) {
+      ::new (record->args) tuple_type{store(args)...};
+      record->format = &format_args<tuple_type>;
+      record->fmt = fmt;
+    } else {
+      // too big to copy; format on this thread instead
+      using string_type = inline_string_t<record_t::kArgsSize - 8>;
+      using preformat_type = std::tuple<string_type>;
+      std::string str;
+      std::apply([&](const auto&... arg) {
+        str = std::vformat(fmt, std::make_format_args(arg...));
+      }, tuple_type{store(args)...});
+      ::new (record->args) preformat_type{string_type{str}};
+      record->format = &format_args<preformat_type>;
+      record->fmt = "{}";
+    }
+    record->error = error;
+    ring.publish();
+  }
+}  // namespace cope::log::async
+
+template <std::size_t N>
+struct std::formatter<cope::log::async::inline_string_t<N>>
+    : std::formatter<std::string_view> {
+  auto format(const cope::log::async::inline_string_t<N>& str,
+      format_context& ctx) const {
+    return std::formatter<std::string_view>::format(str.view(), ctx);
+  }
+};
+
+#endif  // INCLUDE_COPE_LOG_ASYNC_H